@@ -0,0 +1,138 @@
+#include "arena.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// Chunk header; the usable bytes follow it at ARENA_CHUNK_HEADER
+typedef struct ArenaChunk {
+    _Atomic(struct ArenaChunk*) next;  // Newer chunk
+    size_t size;                       // Usable bytes
+    _Alignas(QUEUE_CACHELINE) atomic_size_t used;  // Bytes handed out (may run past size)
+} ArenaChunk;
+
+// Offset of the usable bytes from the start of a chunk
+#define ARENA_CHUNK_HEADER ((sizeof(ArenaChunk) + QUEUE_CACHELINE - 1) & ~(size_t)(QUEUE_CACHELINE - 1))
+
+// Round a request up to the allocation alignment
+static inline size_t arena_round(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+// Allocate an empty chunk with size usable bytes
+static ArenaChunk* chunk_create(size_t size) {
+    if (size > SIZE_MAX - ARENA_CHUNK_HEADER) {
+        return NULL;
+    }
+    ArenaChunk* chunk = (ArenaChunk*)queue_mem_alloc_aligned(QUEUE_CACHELINE, ARENA_CHUNK_HEADER + size);
+    if (chunk == NULL) {
+        return NULL;
+    }
+    atomic_init(&chunk->next, (ArenaChunk*)NULL);
+    chunk->size = size;
+    atomic_init(&chunk->used, 0);
+    return chunk;
+}
+
+// Create an arena with chunks of chunk_bytes (0: ARENA_CHUNK_BYTES)
+PayloadArena* arena_create(size_t chunk_bytes) {
+    if (chunk_bytes == 0) {
+        chunk_bytes = ARENA_CHUNK_BYTES;
+    }
+    chunk_bytes = arena_round(chunk_bytes);
+    
+    PayloadArena* arena = (PayloadArena*)queue_mem_alloc_aligned(_Alignof(PayloadArena), sizeof(PayloadArena));
+    if (arena == NULL) {
+        return NULL;
+    }
+    ArenaChunk* first = chunk_create(chunk_bytes);
+    if (first == NULL) {
+        queue_mem_free_aligned(arena);
+        return NULL;
+    }
+    arena->chunk_bytes = chunk_bytes;
+    arena->first = first;
+    atomic_init(&arena->current, first);
+    return arena;
+}
+
+// Free the arena and every chunk
+// Must not be called while other threads are still using the arena
+void arena_destroy(PayloadArena* arena) {
+    if (arena == NULL) {
+        return;
+    }
+    ArenaChunk* chunk = arena->first;
+    while (chunk != NULL) {
+        ArenaChunk* next = atomic_load_explicit(&chunk->next, memory_order_relaxed);
+        queue_mem_free_aligned(chunk);
+        chunk = next;
+    }
+    queue_mem_free_aligned(arena);
+}
+
+// Allocate size bytes (aligned to ARENA_ALIGNMENT); NULL if out of memory
+// The memory stays valid until the next arena_reset
+void* arena_alloc(PayloadArena* arena, size_t size) {
+    if (arena == NULL || size == 0 || size > SIZE_MAX / 2) {
+        return NULL;
+    }
+    size = arena_round(size);
+    
+    ArenaChunk* chunk = atomic_load_explicit(&arena->current, memory_order_acquire);
+    while (true) {
+        size_t offset = atomic_fetch_add_explicit(&chunk->used, size, memory_order_relaxed);
+        if (offset + size <= chunk->size) {
+            return (unsigned char*)chunk + ARENA_CHUNK_HEADER + offset;
+        }
+        
+        // Chunk exhausted: continue in the next one, chaining it if needed
+        ArenaChunk* next = atomic_load_explicit(&chunk->next, memory_order_acquire);
+        if (next == NULL) {
+            ArenaChunk* fresh = chunk_create(size > arena->chunk_bytes ? size : arena->chunk_bytes);
+            if (fresh == NULL) {
+                return NULL;
+            }
+            if (atomic_compare_exchange_strong_explicit(&chunk->next, &next, fresh,
+                                                        memory_order_acq_rel,
+                                                        memory_order_acquire)) {
+                next = fresh;
+            } else {
+                queue_mem_free_aligned(fresh);  // Another thread chained one first
+            }
+        }
+        
+        // Help current forward (failing just means someone else already did)
+        ArenaChunk* expected = chunk;
+        atomic_compare_exchange_strong_explicit(&arena->current, &expected, next,
+                                                memory_order_release,
+                                                memory_order_relaxed);
+        chunk = next;
+    }
+}
+
+// Make all arena memory reusable; every pointer handed out becomes invalid
+// Chunks are kept for the next round, so a steady workload stops allocating.
+// Must not be called while other threads are still using the arena.
+void arena_reset(PayloadArena* arena) {
+    if (arena == NULL) {
+        return;
+    }
+    for (ArenaChunk* chunk = arena->first; chunk != NULL;
+         chunk = atomic_load_explicit(&chunk->next, memory_order_relaxed)) {
+        atomic_store_explicit(&chunk->used, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&arena->current, arena->first, memory_order_release);
+}
+
+// Get the number of bytes handed out since the last reset (approximate while in use)
+size_t arena_used(PayloadArena* arena) {
+    if (arena == NULL) {
+        return 0;
+    }
+    size_t total = 0;
+    for (ArenaChunk* chunk = arena->first; chunk != NULL;
+         chunk = atomic_load_explicit(&chunk->next, memory_order_acquire)) {
+        size_t used = atomic_load_explicit(&chunk->used, memory_order_relaxed);
+        total += used < chunk->size ? used : chunk->size;
+    }
+    return total;
+}
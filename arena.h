@@ -0,0 +1,45 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "queue_mem.h"
+
+// Bump allocator for payload copies (released all at once)
+//
+// Memory comes from chunks that are carved up front to back with one
+// fetch-and-add per allocation; nothing is freed individually. When a chunk
+// runs out, the allocation that overflowed it chains on the next one (or
+// moves on to a chunk kept from before the last reset). arena_reset() makes
+// every chunk reusable in one step, and arena_destroy() frees them.
+//
+// Any number of threads may allocate at once; reset and destroy must not
+// overlap any other use of the arena.
+
+// Default bytes per chunk (larger allocations get a chunk of their own size)
+#ifndef ARENA_CHUNK_BYTES
+#define ARENA_CHUNK_BYTES (64u * 1024)
+#endif
+
+// Alignment of every allocation
+#define ARENA_ALIGNMENT 16
+
+// Chunk of arena memory (defined in arena.c)
+struct ArenaChunk;
+
+// Arena
+typedef struct PayloadArena {
+    size_t chunk_bytes;                         // Size of ordinary chunks
+    struct ArenaChunk* first;                   // Oldest chunk (start of the chain)
+    _Alignas(QUEUE_CACHELINE) _Atomic(struct ArenaChunk*) current;  // Chunk being carved (may lag)
+} PayloadArena;
+
+// Function declarations
+PayloadArena* arena_create(size_t chunk_bytes);
+void arena_destroy(PayloadArena* arena);
+void* arena_alloc(PayloadArena* arena, size_t size);
+void arena_reset(PayloadArena* arena);
+size_t arena_used(PayloadArena* arena);
+
+#endif // ARENA_H
@@ -0,0 +1,129 @@
+#include "backoff.h"
+#include <stddef.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sched.h>
+#endif
+
+// Fixed-point scale of the contention estimate (failures per operation)
+#define CONTENTION_ONE 256
+
+// Estimate at which the adaptive policy starts waiting on the first failure
+#define CONTENTION_THRESHOLD (CONTENTION_ONE / 4)
+
+// Per-thread exponential moving average of failed attempts per operation
+// Kept per thread rather than per queue so updating it never touches shared memory
+static _Thread_local unsigned int local_contention = 0;
+
+// Per-thread jitter generator state (xorshift32, 0 means unseeded)
+static _Thread_local uint32_t local_seed = 0;
+
+// Next jitter value in [0, 2^32)
+static uint32_t jitter_next(void) {
+    uint32_t x = local_seed;
+    if (x == 0) {
+        x = (uint32_t)(uintptr_t)&local_seed | 1u;  // Distinct per thread
+    }
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    local_seed = x;
+    return x;
+}
+
+// Give up the rest of the time slice
+static void thread_yield(void) {
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+// Configuration with the default tuning for a policy
+BackoffConfig backoff_config_default(BackoffPolicy policy) {
+    BackoffConfig config;
+    config.policy = policy;
+    config.min_spins = BACKOFF_DEFAULT_MIN_SPINS;
+    config.max_spins = BACKOFF_DEFAULT_MAX_SPINS;
+    config.yield_after = BACKOFF_DEFAULT_YIELD_AFTER;
+    config.jitter = true;
+    return config;
+}
+
+// Check that a configuration is usable
+bool backoff_config_valid(const BackoffConfig* config) {
+    if (config == NULL) {
+        return false;
+    }
+    switch (config->policy) {
+    case BACKOFF_NONE:
+        return true;
+    case BACKOFF_SPIN:
+    case BACKOFF_EXPONENTIAL:
+    case BACKOFF_ADAPTIVE:
+        return config->min_spins > 0 && config->min_spins <= config->max_spins;
+    }
+    return false;
+}
+
+// Spin limit for the first wait of an operation
+static unsigned int initial_limit(const BackoffConfig* config) {
+    if (config->policy != BACKOFF_ADAPTIVE) {
+        return config->min_spins;
+    }
+    
+    // Below the threshold a lone failure is most likely bad luck: retry at
+    // once. Above it, start further up the exponential ramp the more this
+    // thread has been failing lately.
+    unsigned int contention = local_contention;
+    if (contention < CONTENTION_THRESHOLD) {
+        return 0;
+    }
+    unsigned int limit = config->min_spins;
+    for (unsigned int c = contention; c >= CONTENTION_ONE && limit < config->max_spins; c >>= 1) {
+        limit <<= 1;
+    }
+    return limit < config->max_spins ? limit : config->max_spins;
+}
+
+// Wait after a failed attempt
+void backoff_wait(Backoff* backoff) {
+    const BackoffConfig* config = backoff->config;
+    if (config->policy == BACKOFF_NONE) {
+        return;
+    }
+    
+    backoff->failures++;
+    if (backoff->failures == 1) {
+        backoff->limit = initial_limit(config);
+    } else if (config->policy != BACKOFF_SPIN) {
+        unsigned int next = backoff->limit == 0 ? config->min_spins : backoff->limit << 1;
+        backoff->limit = next < config->max_spins ? next : config->max_spins;
+    }
+    
+    if (config->yield_after != 0 && backoff->failures >= config->yield_after) {
+        thread_yield();
+        return;
+    }
+    
+    unsigned int spins = backoff->limit;
+    if (config->jitter && spins > 1) {
+        spins = spins / 2 + jitter_next() % (spins - spins / 2 + 1);
+    }
+    for (unsigned int i = 0; i < spins; i++) {
+        backoff_cpu_relax();
+    }
+}
+
+// Finish an operation
+void backoff_done(Backoff* backoff) {
+    if (backoff->config->policy != BACKOFF_ADAPTIVE) {
+        return;
+    }
+    
+    // Moving average with weight 1/8 for the newest operation
+    unsigned int failures = backoff->failures < 64 ? backoff->failures : 64;
+    local_contention = local_contention - local_contention / 8 + failures * CONTENTION_ONE / 8;
+}
@@ -0,0 +1,86 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Contention backoff for CAS retry loops
+//
+// Retrying a failed CAS immediately sends every contending thread straight
+// back to the same cache line, so under heavy contention most attempts fail
+// again. Waiting a little after a failure spreads the attempts out. The wait
+// is spent in the CPU's spin-wait hint (pause on x86, yield on ARM), which
+// keeps the core from hammering the line and frees pipeline resources for
+// a sibling hyperthread; after enough failures the thread yields its time
+// slice instead.
+
+// How a retry loop waits after a failed CAS
+typedef enum BackoffPolicy {
+    BACKOFF_NONE = 0,         // Retry immediately
+    BACKOFF_SPIN = 1,         // Spin a fixed min_spins hints before every retry
+    BACKOFF_EXPONENTIAL = 2,  // Double the spin limit on every failure up to max_spins
+    BACKOFF_ADAPTIVE = 3,     // Exponential, scaled by the retries this thread has seen recently
+} BackoffPolicy;
+
+// Default tuning used by backoff_config_default
+#define BACKOFF_DEFAULT_MIN_SPINS   4
+#define BACKOFF_DEFAULT_MAX_SPINS   1024
+#define BACKOFF_DEFAULT_YIELD_AFTER 16
+
+// Backoff configuration
+typedef struct BackoffConfig {
+    BackoffPolicy policy;
+    unsigned int min_spins;    // Spin limit after the first failure (at least 1 unless policy is NONE)
+    unsigned int max_spins;    // Largest spin limit
+    unsigned int yield_after;  // Consecutive failures after which the thread yields (0: never)
+    bool jitter;               // Randomize every wait between half the limit and the limit
+} BackoffConfig;
+
+// Backoff state for one operation (lives on the stack of the retrying thread)
+typedef struct Backoff {
+    const BackoffConfig* config;
+    unsigned int limit;        // Current spin limit
+    unsigned int failures;     // Failed attempts so far
+} Backoff;
+
+// Hint to the CPU that the thread is spin-waiting
+static inline void backoff_cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+    __yield();
+#endif
+}
+
+// Start backing off for one operation
+static inline void backoff_init(Backoff* backoff, const BackoffConfig* config) {
+    backoff->config = config;
+    backoff->limit = 0;
+    backoff->failures = 0;
+}
+
+// Check whether the policy waits at all
+static inline bool backoff_enabled(const Backoff* backoff) {
+    return backoff->config->policy != BACKOFF_NONE;
+}
+
+// Configuration with the default tuning for a policy
+BackoffConfig backoff_config_default(BackoffPolicy policy);
+
+// Check that a configuration is usable
+bool backoff_config_valid(const BackoffConfig* config);
+
+// Wait after a failed attempt
+void backoff_wait(Backoff* backoff);
+
+// Finish an operation (feeds the adaptive policy's contention estimate)
+void backoff_done(Backoff* backoff);
+
+#endif // BACKOFF_H
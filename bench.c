@@ -0,0 +1,448 @@
+#define _GNU_SOURCE
+#include "queue.h"
+#include "ring.h"
+#include "sharded.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Queue throughput and latency benchmark
+//
+// Sweeps producer/consumer counts, payload sizes and batch sizes over the
+// list queue (in every mode that fits the thread counts), the segment queue,
+// a sharded queue with one lane per thread and the bounded ring. Every thread is pinned to a CPU, waits at a common start line and
+// times each operation with the monotonic clock. The report shows
+// throughput, p50/p99/p99.9 latency of enqueue and dequeue calls, and CAS
+// retries per element. The list queue copies every payload in and hands a
+// heap copy out; the ring passes references, so its payload column only
+// records what the other runs copied.
+//
+// Usage: queue_bench [elements per producer] [--quick]
+
+// Ring capacity used for the ring runs
+#define BENCH_RING_CAPACITY 1024
+
+// Largest payload in the sweep
+#define BENCH_MAX_PAYLOAD 1024
+
+// Largest batch in the sweep
+#define BENCH_MAX_BATCH 64
+
+// Latency histogram: 16 linear sub-buckets per power of two of nanoseconds
+#define HIST_SUB_BITS 4
+#define HIST_SUB (1u << HIST_SUB_BITS)
+#define HIST_BUCKETS (64 * HIST_SUB)
+
+typedef struct Histogram {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+} Histogram;
+
+// Queue implementation under test
+typedef enum BenchKind {
+    BENCH_LIST_MPMC,
+    BENCH_LIST_MPSC,
+    BENCH_LIST_SPSC,
+    BENCH_SEGMENT,
+    BENCH_SHARDED,
+    BENCH_RING,
+} BenchKind;
+
+static const char* kind_names[] = { "list/mpmc", "list/mpsc", "list/spsc", "segment", "sharded", "ring" };
+
+// One point of the sweep
+typedef struct BenchConfig {
+    BenchKind kind;
+    int producers;
+    int consumers;
+    size_t payload;
+    size_t batch;
+    size_t elements;          // Elements per producer
+} BenchConfig;
+
+// State shared by the threads of one run
+typedef struct BenchRun {
+    const BenchConfig* config;
+    Queue* queue;
+    ShardedQueue* sharded;
+    RingQueue* ring;
+    atomic_int ready;         // Threads at the start line
+    atomic_bool go;           // Start signal
+    atomic_int producers_left;
+} BenchRun;
+
+// Per-thread arguments and results
+typedef struct BenchThread {
+    BenchRun* run;
+    int cpu;
+    bool producer;
+    Histogram hist;
+    uint64_t elements;
+} BenchThread;
+
+static int cpu_count = 1;
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Map a latency to its histogram bucket
+static inline size_t hist_bucket(uint64_t ns) {
+    if (ns < HIST_SUB) {
+        return (size_t)ns;
+    }
+    unsigned int msb = 63u - (unsigned int)__builtin_clzll(ns);
+    uint64_t sub = (ns >> (msb - HIST_SUB_BITS)) & (HIST_SUB - 1);
+    return (size_t)(msb - HIST_SUB_BITS + 1) * HIST_SUB + (size_t)sub;
+}
+
+// Upper bound (in ns) of the values mapped to a bucket
+static uint64_t hist_bucket_limit(size_t bucket) {
+    if (bucket < HIST_SUB) {
+        return bucket;
+    }
+    unsigned int msb = (unsigned int)(bucket / HIST_SUB) + HIST_SUB_BITS - 1;
+    uint64_t sub = bucket % HIST_SUB;
+    return ((HIST_SUB + sub + 1) << (msb - HIST_SUB_BITS)) - 1;
+}
+
+// Record count operations that took ns nanoseconds in total
+static inline void hist_record(Histogram* hist, uint64_t ns, size_t count) {
+    hist->counts[hist_bucket(ns / count)] += count;
+    hist->total += count;
+}
+
+static void hist_merge(Histogram* into, const Histogram* from) {
+    for (size_t i = 0; i < HIST_BUCKETS; i++) {
+        into->counts[i] += from->counts[i];
+    }
+    into->total += from->total;
+}
+
+// Latency at or below which the given fraction of operations completed
+static uint64_t hist_percentile(const Histogram* hist, double fraction) {
+    if (hist->total == 0) {
+        return 0;
+    }
+    uint64_t target = (uint64_t)((double)hist->total * fraction);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen > target) {
+            return hist_bucket_limit(i);
+        }
+    }
+    return hist_bucket_limit(HIST_BUCKETS - 1);
+}
+
+// Pin the calling thread to a CPU (best effort)
+static void pin_to_cpu(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu % cpu_count, &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)cpu;
+#endif
+}
+
+// Wait until every thread of the run is ready
+static void start_line(BenchRun* run) {
+    atomic_fetch_add(&run->ready, 1);
+    while (!atomic_load_explicit(&run->go, memory_order_acquire)) {
+        backoff_cpu_relax();
+    }
+}
+
+// Wait for the other side to make progress; yields now and then so the
+// run still completes when there are more threads than CPUs
+static inline void idle_wait(unsigned int* spins) {
+    if (++*spins % 64 == 0) {
+        sched_yield();
+    } else {
+        backoff_cpu_relax();
+    }
+}
+
+static void* producer_main(void* arg) {
+    BenchThread* self = (BenchThread*)arg;
+    BenchRun* run = self->run;
+    const BenchConfig* config = run->config;
+    pin_to_cpu(self->cpu);
+    
+    unsigned char payload[BENCH_MAX_PAYLOAD];
+    memset(payload, 0xab, sizeof(payload));
+    const void* items[BENCH_MAX_BATCH];
+    size_t lengths[BENCH_MAX_BATCH];
+    for (size_t i = 0; i < BENCH_MAX_BATCH; i++) {
+        items[i] = payload;
+        lengths[i] = config->payload;
+    }
+    
+    start_line(run);
+    
+    size_t sent = 0;
+    while (sent < config->elements) {
+        size_t n = config->elements - sent < config->batch ? config->elements - sent : config->batch;
+        uint64_t start = now_ns();
+        if (config->kind == BENCH_RING) {
+            // The ring stores references; wait while it is full
+            unsigned int spins = 0;
+            for (size_t i = 0; i < n; i++) {
+                while (!ring_try_enqueue(run->ring, payload, config->payload)) {
+                    idle_wait(&spins);
+                }
+            }
+        } else if (config->kind == BENCH_SHARDED) {
+            for (size_t i = 0; i < n; i++) {
+                sharded_queue_enqueue(run->sharded, payload, config->payload);
+            }
+        } else if (n == 1) {
+            queue_enqueue(run->queue, payload, config->payload);
+        } else {
+            queue_enqueue_batch(run->queue, items, lengths, n);
+        }
+        hist_record(&self->hist, now_ns() - start, n);
+        sent += n;
+    }
+    
+    self->elements = sent;
+    atomic_fetch_sub_explicit(&run->producers_left, 1, memory_order_release);
+    return NULL;
+}
+
+static void* consumer_main(void* arg) {
+    BenchThread* self = (BenchThread*)arg;
+    BenchRun* run = self->run;
+    const BenchConfig* config = run->config;
+    pin_to_cpu(self->cpu);
+    
+    void* out[BENCH_MAX_BATCH];
+    size_t lens[BENCH_MAX_BATCH];
+    
+    start_line(run);
+    
+    uint64_t received = 0;
+    unsigned int spins = 0;
+    while (true) {
+        // Read before trying, so an empty result after the last producer
+        // finished really means the queue is drained
+        bool producers_done = atomic_load_explicit(&run->producers_left, memory_order_acquire) == 0;
+        
+        uint64_t start = now_ns();
+        size_t n = 0;
+        if (config->kind == BENCH_RING) {
+            while (n < config->batch && ring_try_dequeue(run->ring, &out[n], &lens[n])) {
+                n++;
+            }
+        } else if (config->kind == BENCH_SHARDED) {
+            while (n < config->batch && sharded_queue_dequeue(run->sharded, &out[n], &lens[n])) {
+                n++;
+            }
+        } else if (config->batch == 1) {
+            n = queue_dequeue(run->queue, &out[0], &lens[0]) ? 1 : 0;
+        } else {
+            n = queue_dequeue_batch(run->queue, out, lens, config->batch);
+        }
+        
+        if (n == 0) {
+            if (producers_done) {
+                break;
+            }
+            idle_wait(&spins);
+            continue;
+        }
+        hist_record(&self->hist, now_ns() - start, n);
+        
+        if (config->kind != BENCH_RING) {
+            for (size_t i = 0; i < n; i++) {
+                free(out[i]);
+            }
+        }
+        received += n;
+    }
+    
+    self->elements = received;
+    return NULL;
+}
+
+// Run one point of the sweep and print its report line
+static bool bench_run(const BenchConfig* config) {
+    BenchRun run;
+    memset(&run, 0, sizeof(run));
+    run.config = config;
+    atomic_init(&run.ready, 0);
+    atomic_init(&run.go, false);
+    atomic_init(&run.producers_left, config->producers);
+    
+    if (config->kind == BENCH_RING) {
+        run.ring = ring_init(BENCH_RING_CAPACITY);
+        if (run.ring == NULL) {
+            return false;
+        }
+    } else if (config->kind == BENCH_SHARDED) {
+        // One lane per thread on the busier side
+        int lanes = config->producers > config->consumers ? config->producers : config->consumers;
+        run.sharded = sharded_queue_init((size_t)lanes, QUEUE_MODE_MPMC, LANE_POLICY_THREAD);
+        if (run.sharded == NULL) {
+            return false;
+        }
+    } else {
+        QueueMode mode = config->kind == BENCH_LIST_SPSC ? QUEUE_MODE_SPSC
+                       : config->kind == BENCH_LIST_MPSC ? QUEUE_MODE_MPSC
+                       : config->kind == BENCH_SEGMENT ? QUEUE_MODE_SEGMENT : QUEUE_MODE_MPMC;
+        run.queue = queue_init_mode(mode);
+        if (run.queue == NULL) {
+            return false;
+        }
+    }
+    
+    int total = config->producers + config->consumers;
+    BenchThread* threads = (BenchThread*)calloc((size_t)total, sizeof(BenchThread));
+    pthread_t* handles = (pthread_t*)calloc((size_t)total, sizeof(pthread_t));
+    if (threads == NULL || handles == NULL) {
+        free(threads);
+        free(handles);
+        queue_destroy(run.queue);
+        sharded_queue_destroy(run.sharded);
+        ring_destroy(run.ring);
+        return false;
+    }
+    
+    for (int i = 0; i < total; i++) {
+        threads[i].run = &run;
+        threads[i].cpu = i;
+        threads[i].producer = i < config->producers;
+        pthread_create(&handles[i], NULL, threads[i].producer ? producer_main : consumer_main, &threads[i]);
+    }
+    
+    while (atomic_load(&run.ready) < total) {
+        sched_yield();
+    }
+    uint64_t start = now_ns();
+    atomic_store_explicit(&run.go, true, memory_order_release);
+    for (int i = 0; i < total; i++) {
+        pthread_join(handles[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+    
+    Histogram enq, deq;
+    memset(&enq, 0, sizeof(enq));
+    memset(&deq, 0, sizeof(deq));
+    uint64_t transferred = 0;
+    for (int i = 0; i < total; i++) {
+        if (threads[i].producer) {
+            hist_merge(&enq, &threads[i].hist);
+        } else {
+            hist_merge(&deq, &threads[i].hist);
+            transferred += threads[i].elements;
+        }
+    }
+    
+    double enq_retries = 0.0;
+    double deq_retries = 0.0;
+    if (run.queue != NULL || run.sharded != NULL) {
+        QueueStats stats;
+        if (run.queue != NULL) {
+            queue_get_stats(run.queue, &stats);
+        } else {
+            sharded_queue_get_stats(run.sharded, &stats);
+        }
+        if (transferred > 0) {
+            enq_retries = (double)stats.enqueue_retries / (double)transferred;
+            deq_retries = (double)stats.dequeue_retries / (double)transferred;
+        }
+    }
+    
+    printf("%-10s %2d %2d %7zu %5zu %9.2f %7llu %7llu %8llu %7llu %7llu %8llu %8.3f %8.3f\n",
+           kind_names[config->kind], config->producers, config->consumers,
+           config->payload, config->batch,
+           elapsed > 0 ? (double)transferred * 1000.0 / (double)elapsed : 0.0,
+           (unsigned long long)hist_percentile(&enq, 0.50),
+           (unsigned long long)hist_percentile(&enq, 0.99),
+           (unsigned long long)hist_percentile(&enq, 0.999),
+           (unsigned long long)hist_percentile(&deq, 0.50),
+           (unsigned long long)hist_percentile(&deq, 0.99),
+           (unsigned long long)hist_percentile(&deq, 0.999),
+           enq_retries, deq_retries);
+    fflush(stdout);
+    
+    free(threads);
+    free(handles);
+    queue_destroy(run.queue);
+    sharded_queue_destroy(run.sharded);
+    ring_destroy(run.ring);
+    return transferred == (uint64_t)config->producers * config->elements;
+}
+
+int main(int argc, char** argv) {
+    size_t elements = 200000;
+    bool quick = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else {
+            elements = (size_t)strtoull(argv[i], NULL, 10);
+        }
+    }
+    if (elements == 0) {
+        fprintf(stderr, "usage: %s [elements per producer] [--quick]\n", argv[0]);
+        return 1;
+    }
+    
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_count = cpus > 0 ? (int)cpus : 1;
+    
+    static const int thread_counts[] = { 1, 2, 4 };
+    static const size_t payloads[] = { 8, 64, 1024 };
+    static const size_t batches[] = { 1, 16, 64 };
+    size_t thread_variants = quick ? 2 : sizeof(thread_counts) / sizeof(thread_counts[0]);
+    size_t payload_variants = quick ? 2 : sizeof(payloads) / sizeof(payloads[0]);
+    size_t batch_variants = quick ? 2 : sizeof(batches) / sizeof(batches[0]);
+    
+    printf("Queue benchmark: %zu elements per producer, %d CPUs\n", elements, cpu_count);
+    printf("Throughput in million elements per second, latency in ns per element (batch calls are divided by the batch size)\n\n");
+    printf("%-10s %2s %2s %7s %5s %9s %7s %7s %8s %7s %7s %8s %8s %8s\n",
+           "queue", "P", "C", "payload", "batch", "Mops/s",
+           "enq50", "enq99", "enq99.9", "deq50", "deq99", "deq99.9", "enq-rt", "deq-rt");
+    
+    bool ok = true;
+    for (size_t p = 0; p < thread_variants; p++) {
+        for (size_t c = 0; c < thread_variants; c++) {
+            for (size_t s = 0; s < payload_variants; s++) {
+                for (size_t b = 0; b < batch_variants; b++) {
+                    BenchConfig config;
+                    config.producers = thread_counts[p];
+                    config.consumers = thread_counts[c];
+                    config.payload = payloads[s];
+                    config.batch = batches[b];
+                    config.elements = elements;
+                    
+                    // Every list mode that is valid for these thread counts, then the ring
+                    for (int kind = BENCH_LIST_MPMC; kind <= BENCH_RING; kind++) {
+                        if (kind == BENCH_LIST_MPSC && config.consumers != 1) {
+                            continue;
+                        }
+                        if (kind == BENCH_LIST_SPSC && (config.producers != 1 || config.consumers != 1)) {
+                            continue;
+                        }
+                        config.kind = (BenchKind)kind;
+                        if (!bench_run(&config)) {
+                            fprintf(stderr, "%s run lost elements or failed to start\n", kind_names[kind]);
+                            ok = false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    return ok ? 0 : 1;
+}
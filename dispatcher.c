@@ -0,0 +1,195 @@
+#define _GNU_SOURCE
+#include "dispatcher.h"
+#include "backoff.h"
+#include <stdlib.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+// Pin the calling thread to a CPU (best effort)
+static void pin_to_cpu(int cpu) {
+#ifdef __linux__
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+#else
+    (void)cpu;
+#endif
+}
+
+// CPU for worker index: the index-th CPU in the process's affinity mask,
+// wrapping around (-1 where affinity is not supported)
+static int worker_cpu(int index) {
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return -1;
+    }
+    int count = CPU_COUNT(&allowed);
+    if (count <= 0) {
+        return -1;
+    }
+    int skip = index % count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &allowed) && skip-- == 0) {
+            return cpu;
+        }
+    }
+    return -1;
+#else
+    (void)index;
+    return -1;
+#endif
+}
+
+// Wait until the queue has elements or the dispatcher is stopping
+// Spins briefly first, then parks on the queue's eventcount
+static void worker_idle(QueueDispatcher* dispatcher) {
+    Queue* queue = dispatcher->queue;
+    for (unsigned int i = 0; i < QUEUE_WAIT_SPINS; i++) {
+        backoff_cpu_relax();
+        if (!queue_is_empty(queue) || atomic_load_explicit(&dispatcher->stopping, memory_order_acquire) ||
+            queue_is_closed(queue)) {
+            return;
+        }
+    }
+    
+    // Announce the wait before the last check, so an enqueue (or a stop or
+    // close) that lands after the check is guaranteed to see us and wake us
+    uint32_t key = eventcount_prepare_wait(&queue->not_empty);
+    if (!queue_is_empty(queue) || atomic_load_explicit(&dispatcher->stopping, memory_order_acquire) ||
+        queue_is_closed(queue)) {
+        eventcount_cancel_wait(&queue->not_empty);
+        return;
+    }
+    eventcount_wait(&queue->not_empty, key, EVENTCOUNT_FOREVER);
+}
+
+// Release an element once the handler is done with it: a buffer enqueued
+// owned goes to the queue's destructor if one is set, anything else (the
+// queue's own copies) to free()
+static inline void release_item(Queue* queue, void* data, size_t length, bool owned) {
+    if (owned && queue->destructor != NULL) {
+        queue->destructor(data, length);
+    } else {
+        free(data);
+    }
+}
+
+// Worker thread: dequeue in batches and hand each element to the handler
+static void* worker_main(void* arg) {
+    DispatcherWorker* worker = (DispatcherWorker*)arg;
+    QueueDispatcher* dispatcher = worker->dispatcher;
+    pin_to_cpu(worker->cpu);
+    
+    void* items[DISPATCHER_BATCH];
+    size_t lengths[DISPATCHER_BATCH];
+    bool owned[DISPATCHER_BATCH];
+    while (true) {
+        size_t count = queue_dequeue_batch_owned(dispatcher->queue, items, lengths, owned, DISPATCHER_BATCH);
+        for (size_t i = 0; i < count; i++) {
+            dispatcher->handler(items[i], lengths[i], dispatcher->ctx);
+            release_item(dispatcher->queue, items[i], lengths[i], owned[i]);
+        }
+        if (count > 0) {
+            atomic_fetch_add_explicit(&dispatcher->handled, count, memory_order_relaxed);
+        }
+        
+        if (atomic_load_explicit(&dispatcher->stopping, memory_order_acquire)) {
+            // A draining stop exits only once the queue has been emptied
+            if (!atomic_load_explicit(&dispatcher->drain, memory_order_relaxed) || queue_is_empty(dispatcher->queue)) {
+                break;
+            }
+            if (count == 0) {
+                backoff_cpu_relax();  // An element is still being linked in
+            }
+        } else if (count == 0 && queue_is_closed(dispatcher->queue)) {
+            // Closed queue: exit once it is drained (nothing more can arrive)
+            if (atomic_load_explicit(&dispatcher->queue->closed, memory_order_acquire) == QUEUE_CLOSED &&
+                queue_is_empty(dispatcher->queue)) {
+                break;
+            }
+            backoff_cpu_relax();  // Enqueues in flight or other workers' last dequeues
+        } else if (count == 0) {
+            worker_idle(dispatcher);
+        }
+    }
+    return NULL;
+}
+
+// Stop the first count workers and free the dispatcher
+static void dispatcher_join(QueueDispatcher* dispatcher, int count) {
+    atomic_store_explicit(&dispatcher->stopping, true, memory_order_release);
+    eventcount_notify(&dispatcher->queue->not_empty, true);
+    for (int i = 0; i < count; i++) {
+        pthread_join(dispatcher->workers[i].thread, NULL);
+    }
+    free(dispatcher->workers);
+    free(dispatcher);
+}
+
+// Start nthreads workers that pass every element of queue to handler
+// Returns NULL if the arguments are invalid (including more than one thread
+// on an MPSC or SPSC queue) or a thread cannot be started
+QueueDispatcher* dispatcher_start(Queue* queue, int nthreads, dispatcher_fn handler, void* ctx) {
+    if (queue == NULL || nthreads <= 0 || handler == NULL) {
+        return NULL;
+    }
+    // Single-consumer modes can only be drained by one worker
+    if (nthreads > 1 && (queue->mode == QUEUE_MODE_MPSC || queue->mode == QUEUE_MODE_SPSC)) {
+        return NULL;
+    }
+    
+    QueueDispatcher* dispatcher = (QueueDispatcher*)malloc(sizeof(QueueDispatcher));
+    if (dispatcher == NULL) {
+        return NULL;
+    }
+    dispatcher->workers = (DispatcherWorker*)calloc((size_t)nthreads, sizeof(DispatcherWorker));
+    if (dispatcher->workers == NULL) {
+        free(dispatcher);
+        return NULL;
+    }
+    dispatcher->queue = queue;
+    dispatcher->handler = handler;
+    dispatcher->ctx = ctx;
+    dispatcher->worker_count = nthreads;
+    atomic_init(&dispatcher->stopping, false);
+    atomic_init(&dispatcher->drain, false);
+    atomic_init(&dispatcher->handled, 0);
+    
+    for (int i = 0; i < nthreads; i++) {
+        DispatcherWorker* worker = &dispatcher->workers[i];
+        worker->dispatcher = dispatcher;
+        worker->cpu = worker_cpu(i);
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            // Elements already handled stay handled; the rest stay queued
+            dispatcher_join(dispatcher, i);
+            return NULL;
+        }
+    }
+    return dispatcher;
+}
+
+// Stop the workers and free the dispatcher
+// With drain, workers keep going until the queue is empty (stop the
+// producers first, or this may not return). Without it, each worker finishes
+// its current batch and the remaining elements stay in the queue.
+void dispatcher_stop(QueueDispatcher* dispatcher, bool drain) {
+    if (dispatcher == NULL) {
+        return;
+    }
+    atomic_store_explicit(&dispatcher->drain, drain, memory_order_relaxed);
+    dispatcher_join(dispatcher, dispatcher->worker_count);
+}
+
+// Number of elements passed to the handler so far
+uint64_t dispatcher_handled(QueueDispatcher* dispatcher) {
+    if (dispatcher == NULL) {
+        return 0;
+    }
+    return atomic_load_explicit(&dispatcher->handled, memory_order_relaxed);
+}
@@ -0,0 +1,61 @@
+#ifndef DISPATCHER_H
+#define DISPATCHER_H
+
+#include "queue.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Consumer thread pool for a Queue
+//
+// dispatcher_start() runs worker threads that take elements off a queue and
+// pass each one to a handler, so callers do not write their own poll-and-sleep
+// loop. Workers take up to DISPATCHER_BATCH elements per dequeue. When the
+// queue is empty they spin for QUEUE_WAIT_SPINS checks and then park on the
+// queue's eventcount, so an idle pool makes no system calls and uses no CPU.
+// Producers wake them with the notify every enqueue already does. On Linux
+// worker i is pinned to the i-th CPU the process may run on (wrapping around).
+//
+// The handler borrows each element, and the dispatcher owns it again once the
+// handler returns: a buffer enqueued with queue_enqueue_owned goes to the
+// queue's destructor (queue_set_destructor) if one is set, and the queue's
+// own copies go to free(). A handler that needs the data afterwards must copy
+// it. Handlers run concurrently on different workers, so with more than one
+// thread elements are handled out of order. Workers exit on
+// their own once the queue is closed (queue_close) and drained; the queue
+// must stay alive until dispatcher_stop() returns.
+
+// Elements taken per dequeue by a worker
+#ifndef DISPATCHER_BATCH
+#define DISPATCHER_BATCH 32
+#endif
+
+// Element handler: called on a worker thread, must not free or keep data
+typedef void (*dispatcher_fn)(void* data, size_t length, void* ctx);
+
+// One worker thread
+typedef struct DispatcherWorker {
+    struct QueueDispatcher* dispatcher;
+    pthread_t thread;
+    int cpu;                     // CPU to pin to (-1: not pinned)
+} DispatcherWorker;
+
+// Dispatcher structure
+typedef struct QueueDispatcher {
+    Queue* queue;
+    dispatcher_fn handler;
+    void* ctx;
+    DispatcherWorker* workers;
+    int worker_count;
+    atomic_bool stopping;        // Set by dispatcher_stop
+    atomic_bool drain;           // Finish the queued elements before exiting
+    atomic_uint_fast64_t handled;  // Elements passed to the handler
+} QueueDispatcher;
+
+// Function declarations
+QueueDispatcher* dispatcher_start(Queue* queue, int nthreads, dispatcher_fn handler, void* ctx);
+void dispatcher_stop(QueueDispatcher* dispatcher, bool drain);
+uint64_t dispatcher_handled(QueueDispatcher* dispatcher);
+
+#endif // DISPATCHER_H
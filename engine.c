@@ -0,0 +1,268 @@
+#include "engine.h"
+#include <stdatomic.h>
+
+#if QUEUE_ENGINE_ONLY == 0 || QUEUE_ENGINE_ONLY == QUEUE_ENGINE_ID_LIST
+// List engine: the linked-list Queue in the mode the cardinality allows
+// Many producers contending on one tail make MPMC enqueues retry their CAS,
+// so an MPMC channel that expects many gets the segment queue instead
+static void* list_create(const QueueConfig* config) {
+    QueueMode mode = QUEUE_MODE_MPMC;
+    if (config->single_consumer) {
+        mode = config->single_producer ? QUEUE_MODE_SPSC : QUEUE_MODE_MPSC;
+    } else if (!config->single_producer && config->producers >= QUEUE_ENGINE_SEGMENT_PRODUCERS) {
+        mode = QUEUE_MODE_SEGMENT;
+    }
+    return queue_init_numa(mode, config->numa_node);
+}
+
+static void list_destroy(void* impl) {
+    queue_destroy((Queue*)impl);
+}
+
+static bool list_enqueue(void* impl, const void* data, size_t length) {
+    return queue_enqueue((Queue*)impl, data, length);
+}
+
+static bool list_dequeue(void* impl, void** data, size_t* length) {
+    return queue_dequeue((Queue*)impl, data, length);
+}
+
+static bool list_dequeue_into(void* impl, void* buffer, size_t capacity, size_t* length) {
+    return queue_dequeue_into((Queue*)impl, buffer, capacity, length);
+}
+
+static QueueWaitStatus list_dequeue_wait(void* impl, void** data, size_t* length, uint64_t timeout_ns) {
+    return queue_dequeue_wait((Queue*)impl, data, length, timeout_ns);
+}
+
+static size_t list_size(void* impl) {
+    return queue_size((Queue*)impl);
+}
+
+static const QueueEngine list_engine = {
+    "list",
+    QUEUE_ENGINE_UNBOUNDED | QUEUE_ENGINE_BLOCKING | QUEUE_ENGINE_VARIABLE_SIZE |
+        QUEUE_ENGINE_MULTI_PRODUCER | QUEUE_ENGINE_MULTI_CONSUMER,
+    list_create, list_destroy, list_enqueue, list_dequeue, list_dequeue_into, list_dequeue_wait, list_size
+};
+#endif
+
+#if QUEUE_ENGINE_ONLY == 0 || QUEUE_ENGINE_ONLY == QUEUE_ENGINE_ID_RING
+// Ring engine: capacity rounded up to a power of two (at least 2); a fixed
+// element size gets slots sized to hold it
+static void* ring_create(const QueueConfig* config) {
+    size_t capacity = 2;
+    while (capacity < config->capacity) {
+        if (capacity > SIZE_MAX / 2) {
+            return NULL;
+        }
+        capacity *= 2;
+    }
+    
+    RingEngine* engine = (RingEngine*)queue_mem_alloc_aligned(_Alignof(RingEngine), sizeof(RingEngine));
+    if (engine == NULL) {
+        return NULL;
+    }
+    engine->ring = NULL;
+    engine->slots = NULL;
+    engine->element_size = config->element_size;
+    engine->mask = capacity - 1;
+    atomic_init(&engine->enqueue_pos, 0);
+    atomic_init(&engine->dequeue_pos, 0);
+    
+    if (config->element_size == 0) {
+        engine->stride = 0;
+        engine->ring = ring_init(capacity);
+        if (engine->ring == NULL) {
+            queue_mem_free_aligned(engine);
+            return NULL;
+        }
+        return engine;
+    }
+    
+    // Sequence number, then the element, padded so the next sequence is aligned
+    size_t align = _Alignof(atomic_size_t);
+    if (config->element_size > SIZE_MAX - sizeof(atomic_size_t) - align) {
+        queue_mem_free_aligned(engine);
+        return NULL;
+    }
+    engine->stride = (sizeof(atomic_size_t) + config->element_size + align - 1) & ~(align - 1);
+    if (capacity > SIZE_MAX / engine->stride) {
+        queue_mem_free_aligned(engine);
+        return NULL;
+    }
+    engine->slots = (unsigned char*)queue_mem_alloc_aligned(QUEUE_CACHELINE, capacity * engine->stride);
+    if (engine->slots == NULL) {
+        queue_mem_free_aligned(engine);
+        return NULL;
+    }
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(ring_engine_slot(engine, i), i);
+    }
+    return engine;
+}
+
+static void ring_engine_destroy(void* impl) {
+    RingEngine* engine = (RingEngine*)impl;
+    if (engine->ring != NULL) {
+        ring_destroy(engine->ring);  // Leftover copies are released with free()
+    } else {
+        queue_mem_free_aligned(engine->slots);  // Leftover elements are just bytes
+    }
+    queue_mem_free_aligned(engine);
+}
+
+static size_t ring_engine_size(void* impl) {
+    RingEngine* engine = (RingEngine*)impl;
+    if (engine->ring != NULL) {
+        return ring_size(engine->ring);
+    }
+    size_t dequeued = atomic_load_explicit(&engine->dequeue_pos, memory_order_acquire);
+    size_t enqueued = atomic_load_explicit(&engine->enqueue_pos, memory_order_acquire);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+static const QueueEngine ring_engine = {
+    "ring",
+    QUEUE_ENGINE_BOUNDED | QUEUE_ENGINE_VARIABLE_SIZE | QUEUE_ENGINE_MULTI_PRODUCER |
+        QUEUE_ENGINE_MULTI_CONSUMER,
+    ring_create, ring_engine_destroy, ring_engine_enqueue, ring_engine_dequeue, ring_engine_dequeue_into,
+    NULL, ring_engine_size
+};
+#endif
+
+// Engines by registration order: the built-ins, then queue_register_engine's
+// Slots are claimed with a fetch-and-add and filled afterwards, so a reader
+// may see a slot that is still NULL and skips it
+static const QueueEngine* const builtin_engines[] = {
+#if QUEUE_ENGINE_ONLY == 0 || QUEUE_ENGINE_ONLY == QUEUE_ENGINE_ID_LIST
+    &list_engine,
+#endif
+#if QUEUE_ENGINE_ONLY == 0 || QUEUE_ENGINE_ONLY == QUEUE_ENGINE_ID_RING
+    &ring_engine,
+#endif
+};
+#define BUILTIN_ENGINES (sizeof(builtin_engines) / sizeof(builtin_engines[0]))
+
+static _Atomic(const QueueEngine*) registered_engines[QUEUE_ENGINE_MAX_REGISTERED];
+static atomic_size_t registered_count = 0;
+
+// Engine at index i of the registry (newest first; NULL if not filled in yet)
+static const QueueEngine* engine_at(size_t i, size_t registered) {
+    if (i < registered) {
+        return atomic_load_explicit(&registered_engines[registered - 1 - i], memory_order_acquire);
+    }
+    return builtin_engines[BUILTIN_ENGINES - 1 - (i - registered)];
+}
+
+// Check whether an engine can serve a configuration
+static bool engine_serves(const QueueEngine* engine, const QueueConfig* config) {
+    unsigned int needed = config->capacity > 0 ? QUEUE_ENGINE_BOUNDED : QUEUE_ENGINE_UNBOUNDED;
+    if (config->blocking) {
+        needed |= QUEUE_ENGINE_BLOCKING;
+    }
+    if (config->element_size == 0) {
+        needed |= QUEUE_ENGINE_VARIABLE_SIZE;
+    }
+    if (!config->single_producer) {
+        needed |= QUEUE_ENGINE_MULTI_PRODUCER;
+    }
+    if (!config->single_consumer) {
+        needed |= QUEUE_ENGINE_MULTI_CONSUMER;
+    }
+    return (engine->caps & needed) == needed;
+}
+
+// Default configuration: unbounded MPMC channel of variable-length,
+// non-blocking elements, engine picked automatically
+QueueConfig queue_config_default(void) {
+    QueueConfig config;
+    config.capacity = 0;
+    config.single_producer = false;
+    config.single_consumer = false;
+    config.producers = 0;
+    config.blocking = false;
+    config.element_size = 0;
+    config.numa_node = -1;
+    config.engine = NULL;
+    return config;
+}
+
+// Create a channel backed by the newest engine that serves config (or by the
+// engine config->engine names, if it serves config)
+// Returns NULL if no engine fits or the engine fails to create the channel
+QueueHandle* queue_create(const QueueConfig* config) {
+    if (config == NULL) {
+        return NULL;
+    }
+    
+    size_t registered = atomic_load_explicit(&registered_count, memory_order_acquire);
+    if (registered > QUEUE_ENGINE_MAX_REGISTERED) {
+        registered = QUEUE_ENGINE_MAX_REGISTERED;
+    }
+    const QueueEngine* engine = NULL;
+    for (size_t i = 0; i < registered + BUILTIN_ENGINES && engine == NULL; i++) {
+        const QueueEngine* candidate = engine_at(i, registered);
+        if (candidate == NULL || !engine_serves(candidate, config)) {
+            continue;
+        }
+        if (config->engine == NULL || strcmp(config->engine, candidate->name) == 0) {
+            engine = candidate;
+        }
+    }
+    if (engine == NULL) {
+        return NULL;
+    }
+    
+    QueueHandle* handle = (QueueHandle*)malloc(sizeof(QueueHandle));
+    if (handle == NULL) {
+        return NULL;
+    }
+    handle->engine = engine;
+    handle->element_size = config->element_size;
+    handle->impl = engine->create(config);
+    if (handle->impl == NULL) {
+        free(handle);
+        return NULL;
+    }
+    return handle;
+}
+
+// Destroy a channel, releasing any elements still in it
+// Must not be called while other threads are still using the channel
+void queue_handle_destroy(QueueHandle* handle) {
+    if (handle == NULL) {
+        return;
+    }
+    handle->engine->destroy(handle->impl);
+    free(handle);
+}
+
+// Add an engine to the registry (it is tried before every engine added
+// earlier). The table must stay valid for as long as handles use it.
+// Returns false if the table is incomplete, the registry is full, or the
+// build has a single engine compiled in (QUEUE_ENGINE_ONLY)
+bool queue_register_engine(const QueueEngine* engine) {
+    if (QUEUE_ENGINE_ONLY != 0 || engine == NULL || engine->name == NULL || engine->create == NULL ||
+        engine->destroy == NULL || engine->enqueue == NULL || engine->dequeue == NULL ||
+        engine->dequeue_into == NULL || engine->size == NULL ||
+        ((engine->caps & QUEUE_ENGINE_BLOCKING) && engine->dequeue_wait == NULL)) {
+        return false;
+    }
+    size_t slot = atomic_fetch_add_explicit(&registered_count, 1, memory_order_relaxed);
+    if (slot >= QUEUE_ENGINE_MAX_REGISTERED) {
+        return false;
+    }
+    atomic_store_explicit(&registered_engines[slot], engine, memory_order_release);
+    return true;
+}
+
+// Name of the engine backing a channel
+const char* queue_handle_engine(QueueHandle* handle) {
+    return handle != NULL ? handle->engine->name : NULL;
+}
+
+// Get the number of elements in a channel (approximate while it is in use)
+size_t queue_handle_size(QueueHandle* handle) {
+    return handle != NULL ? handle->engine->size(handle->impl) : 0;
+}
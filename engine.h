@@ -0,0 +1,292 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "queue.h"
+#include "ring.h"
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Queue front end: pick an engine from a configuration
+//
+// queue_create() takes a QueueConfig describing a channel: bounded or not,
+// single or multiple producers and consumers, whether consumers block, and
+// the element size. It returns a QueueHandle backed by the best engine
+// registered for that configuration. Callers use the queue_handle_*
+// functions whatever the engine, so a channel is retuned by changing its
+// config rather than its code.
+//
+// Built-in engines:
+//   "list" - the linked-list Queue (unbounded, blocking); the mode follows
+//            the producer/consumer cardinality (SPSC, MPSC or MPMC), and
+//            a multi-consumer channel expecting at least
+//            QUEUE_ENGINE_SEGMENT_PRODUCERS producers uses the fetch-and-add
+//            segment queue (QUEUE_MODE_SEGMENT) instead of MPMC
+//   "ring" - bounded ring; fixed-size elements are stored in the slots,
+//            variable-size ones as heap copies in a RingQueue
+// queue_register_engine() adds more. Engines are tried newest first, so a
+// registered engine wins over a built-in with the same capabilities.
+//
+// Calls through a handle go through the engine's function table. Build with
+// -DQUEUE_ENGINE_ONLY=QUEUE_ENGINE_ID_LIST (or _RING) to compile a single
+// engine in instead: the handle functions then call it directly, and
+// queue_create() fails for configs that engine cannot serve.
+
+// Engine capabilities
+#define QUEUE_ENGINE_UNBOUNDED      0x01u  // Serves capacity == 0
+#define QUEUE_ENGINE_BOUNDED        0x02u  // Serves capacity > 0
+#define QUEUE_ENGINE_BLOCKING       0x04u  // Implements dequeue_wait
+#define QUEUE_ENGINE_VARIABLE_SIZE  0x08u  // Serves element_size == 0
+#define QUEUE_ENGINE_MULTI_PRODUCER 0x10u  // Takes concurrent enqueues
+#define QUEUE_ENGINE_MULTI_CONSUMER 0x20u  // Takes concurrent dequeues
+
+// Engines that can be compiled in with QUEUE_ENGINE_ONLY
+#define QUEUE_ENGINE_ID_LIST 1
+#define QUEUE_ENGINE_ID_RING 2
+#ifndef QUEUE_ENGINE_ONLY
+#define QUEUE_ENGINE_ONLY 0
+#endif
+
+// Most engines queue_register_engine accepts in addition to the built-ins
+#define QUEUE_ENGINE_MAX_REGISTERED 8
+
+// Expected producer count from which the list engine switches MPMC channels
+// to the segment queue (its enqueues take no CAS retries under contention)
+#ifndef QUEUE_ENGINE_SEGMENT_PRODUCERS
+#define QUEUE_ENGINE_SEGMENT_PRODUCERS 4
+#endif
+
+// Channel configuration (start from queue_config_default)
+typedef struct QueueConfig {
+    size_t capacity;          // 0: unbounded; else at most this many elements (rounded up to a power of two)
+    bool single_producer;     // Only one thread ever enqueues
+    bool single_consumer;     // Only one thread ever dequeues
+    size_t producers;         // Expected concurrent producers (0: unknown); a hint for the engine
+    bool blocking;            // Consumers use queue_handle_dequeue_wait
+    size_t element_size;      // 0: variable-length elements; else every element has exactly this size
+    int numa_node;            // Placement for engines that support it (-1: unbound)
+    const char* engine;       // Engine to use by name (NULL: pick by the fields above)
+} QueueConfig;
+
+// Engine function table
+// impl is whatever create returned. dequeue hands out a malloc'd buffer the
+// caller frees; dequeue_into follows queue_dequeue_into.
+typedef struct QueueEngine {
+    const char* name;
+    unsigned int caps;        // QUEUE_ENGINE_* flags
+    void* (*create)(const QueueConfig* config);
+    void (*destroy)(void* impl);
+    bool (*enqueue)(void* impl, const void* data, size_t length);
+    bool (*dequeue)(void* impl, void** data, size_t* length);
+    bool (*dequeue_into)(void* impl, void* buffer, size_t capacity, size_t* length);
+    QueueWaitStatus (*dequeue_wait)(void* impl, void** data, size_t* length, uint64_t timeout_ns);  // NULL unless BLOCKING
+    size_t (*size)(void* impl);
+} QueueEngine;
+
+// Channel handle returned by queue_create
+typedef struct QueueHandle {
+    const QueueEngine* engine;
+    void* impl;
+    size_t element_size;      // From the config (0: variable)
+} QueueHandle;
+
+// Ring engine state
+// A fixed element size is stored by value in the engine's own slots, with
+// the sequence numbers of ring.h and typed_queue.h, so enqueue and
+// dequeue_into never allocate. Variable-size elements are copied to the heap
+// and passed through a RingQueue.
+typedef struct RingEngine {
+    RingQueue* ring;          // Variable-size elements (NULL for a fixed size)
+    unsigned char* slots;     // Fixed size: mask + 1 slots of stride bytes (sequence, then element)
+    size_t stride;            // Bytes per slot
+    size_t element_size;      // Bytes per element (0: variable)
+    size_t mask;              // Slot count - 1
+    _Alignas(QUEUE_CACHELINE) atomic_size_t enqueue_pos;  // Next position to fill (producers only)
+    _Alignas(QUEUE_CACHELINE) atomic_size_t dequeue_pos;  // Next position to drain (consumers only)
+} RingEngine;
+
+// Sequence number of the slot for position pos (the element follows it)
+static inline atomic_size_t* ring_engine_slot(RingEngine* engine, size_t pos) {
+    return (atomic_size_t*)(engine->slots + (pos & engine->mask) * engine->stride);
+}
+
+// Copy a fixed-size element into the next free slot (false if full)
+static inline bool ring_engine_put(RingEngine* engine, const void* data) {
+    size_t pos = atomic_load_explicit(&engine->enqueue_pos, memory_order_relaxed);
+    atomic_size_t* slot;
+    while (true) {
+        slot = ring_engine_slot(engine, pos);
+        size_t sequence = atomic_load_explicit(slot, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&engine->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;  // Full
+        } else {
+            pos = atomic_load_explicit(&engine->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    memcpy(slot + 1, data, engine->element_size);
+    atomic_store_explicit(slot, pos + 1, memory_order_release);
+    return true;
+}
+
+// Copy the oldest fixed-size element out of its slot (false if empty)
+static inline bool ring_engine_take(RingEngine* engine, void* buffer) {
+    size_t pos = atomic_load_explicit(&engine->dequeue_pos, memory_order_relaxed);
+    atomic_size_t* slot;
+    while (true) {
+        slot = ring_engine_slot(engine, pos);
+        size_t sequence = atomic_load_explicit(slot, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&engine->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;  // Empty
+        } else {
+            pos = atomic_load_explicit(&engine->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    memcpy(buffer, slot + 1, engine->element_size);
+    atomic_store_explicit(slot, pos + engine->mask + 1, memory_order_release);
+    return true;
+}
+
+// Ring engine operations (defined here so QUEUE_ENGINE_ONLY can call them
+// directly). The handle has checked that a fixed-size element has the
+// channel's size and that a dequeue_into buffer holds one.
+static inline bool ring_engine_enqueue(void* impl, const void* data, size_t length) {
+    RingEngine* engine = (RingEngine*)impl;
+    if (engine->ring == NULL) {
+        return ring_engine_put(engine, data);
+    }
+    void* copy = malloc(length > 0 ? length : 1);
+    if (copy == NULL) {
+        return false;
+    }
+    if (length > 0) {
+        memcpy(copy, data, length);
+    }
+    if (!ring_try_enqueue(engine->ring, copy, length)) {
+        free(copy);  // Full
+        return false;
+    }
+    return true;
+}
+
+static inline bool ring_engine_dequeue(void* impl, void** data, size_t* length) {
+    RingEngine* engine = (RingEngine*)impl;
+    if (engine->ring != NULL) {
+        return ring_try_dequeue(engine->ring, data, length);
+    }
+    void* copy = malloc(engine->element_size);
+    if (copy == NULL) {
+        return false;
+    }
+    if (!ring_engine_take(engine, copy)) {
+        free(copy);  // Empty
+        return false;
+    }
+    *data = copy;
+    *length = engine->element_size;
+    return true;
+}
+
+static inline bool ring_engine_dequeue_into(void* impl, void* buffer, size_t capacity, size_t* length) {
+    RingEngine* engine = (RingEngine*)impl;
+    if (engine->ring == NULL) {
+        *length = ring_engine_take(engine, buffer) ? engine->element_size : 0;
+        return *length != 0;
+    }
+    
+    // An element that does not fit stays queued and *length reports its size
+    void* data;
+    if (!ring_try_dequeue_fit(engine->ring, capacity, &data, length)) {
+        return false;
+    }
+    if (*length > 0) {
+        memcpy(buffer, data, *length);
+    }
+    free(data);
+    return true;
+}
+
+// Function declarations
+QueueConfig queue_config_default(void);
+QueueHandle* queue_create(const QueueConfig* config);
+void queue_handle_destroy(QueueHandle* handle);
+bool queue_register_engine(const QueueEngine* engine);
+const char* queue_handle_engine(QueueHandle* handle);
+size_t queue_handle_size(QueueHandle* handle);
+
+// Enqueue a copy of an element
+// Fails if the element does not have the channel's fixed size, or if a
+// bounded channel is full
+static inline bool queue_handle_enqueue(QueueHandle* handle, const void* data, size_t length) {
+    if (handle->element_size != 0 && length != handle->element_size) {
+        return false;
+    }
+#if QUEUE_ENGINE_ONLY == QUEUE_ENGINE_ID_LIST
+    return queue_enqueue((Queue*)handle->impl, data, length);
+#elif QUEUE_ENGINE_ONLY == QUEUE_ENGINE_ID_RING
+    return ring_engine_enqueue(handle->impl, data, length);
+#else
+    return handle->engine->enqueue(handle->impl, data, length);
+#endif
+}
+
+// Dequeue an element into a malloc'd buffer (caller frees *data)
+static inline bool queue_handle_dequeue(QueueHandle* handle, void** data, size_t* length) {
+#if QUEUE_ENGINE_ONLY == QUEUE_ENGINE_ID_LIST
+    return queue_dequeue((Queue*)handle->impl, data, length);
+#elif QUEUE_ENGINE_ONLY == QUEUE_ENGINE_ID_RING
+    return ring_engine_dequeue(handle->impl, data, length);
+#else
+    return handle->engine->dequeue(handle->impl, data, length);
+#endif
+}
+
+// Dequeue an element into buffer, as queue_dequeue_into
+static inline bool queue_handle_dequeue_into(QueueHandle* handle, void* buffer, size_t capacity, size_t* length) {
+    if (handle->element_size != 0 && capacity < handle->element_size) {
+        *length = handle->element_size;  // Too small for any element; nothing is taken
+        return false;
+    }
+#if QUEUE_ENGINE_ONLY == QUEUE_ENGINE_ID_LIST
+    return queue_dequeue_into((Queue*)handle->impl, buffer, capacity, length);
+#elif QUEUE_ENGINE_ONLY == QUEUE_ENGINE_ID_RING
+    return ring_engine_dequeue_into(handle->impl, buffer, capacity, length);
+#else
+    return handle->engine->dequeue_into(handle->impl, buffer, capacity, length);
+#endif
+}
+
+// Dequeue an element, waiting up to timeout_ns for one (as queue_dequeue_wait)
+// Engines without QUEUE_ENGINE_BLOCKING only try once
+static inline QueueWaitStatus queue_handle_dequeue_wait(QueueHandle* handle, void** data, size_t* length,
+                                                        uint64_t timeout_ns) {
+#if QUEUE_ENGINE_ONLY == QUEUE_ENGINE_ID_LIST
+    return queue_dequeue_wait((Queue*)handle->impl, data, length, timeout_ns);
+#else
+#if QUEUE_ENGINE_ONLY == 0
+    if (handle->engine->dequeue_wait != NULL) {
+        return handle->engine->dequeue_wait(handle->impl, data, length, timeout_ns);
+    }
+#endif
+    (void)timeout_ns;
+    return queue_handle_dequeue(handle, data, length) ? QUEUE_WAIT_OK : QUEUE_WAIT_TIMEOUT;
+#endif
+}
+
+#endif // ENGINE_H
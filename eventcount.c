@@ -0,0 +1,163 @@
+#define _GNU_SOURCE
+#include "eventcount.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#if !defined(__linux__) && !defined(_WIN32)
+// Condition variable fallback for systems without an address-wait primitive
+typedef struct EventCountFallback {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} EventCountFallback;
+
+static pthread_mutex_t fallback_create_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Create the fallback pair on first use
+static EventCountFallback* fallback_get(EventCount* ec) {
+    pthread_mutex_lock(&fallback_create_mutex);
+    if (ec->fallback == NULL) {
+        EventCountFallback* fb = (EventCountFallback*)malloc(sizeof(EventCountFallback));
+        if (fb != NULL) {
+            pthread_mutex_init(&fb->mutex, NULL);
+            pthread_cond_init(&fb->cond, NULL);
+        }
+        ec->fallback = fb;
+    }
+    EventCountFallback* fb = (EventCountFallback*)ec->fallback;
+    pthread_mutex_unlock(&fallback_create_mutex);
+    return fb;
+}
+#endif
+
+// Initialize an eventcount with no waiters
+void eventcount_init(EventCount* ec) {
+    atomic_init(&ec->epoch, 0);
+    atomic_init(&ec->waiters, 0);
+#if !defined(__linux__) && !defined(_WIN32)
+    ec->fallback = NULL;
+#endif
+}
+
+// Release resources held by an eventcount
+void eventcount_destroy(EventCount* ec) {
+#if !defined(__linux__) && !defined(_WIN32)
+    EventCountFallback* fb = (EventCountFallback*)ec->fallback;
+    if (fb != NULL) {
+        pthread_cond_destroy(&fb->cond);
+        pthread_mutex_destroy(&fb->mutex);
+        free(fb);
+        ec->fallback = NULL;
+    }
+#else
+    (void)ec;
+#endif
+}
+
+// Announce an upcoming wait
+uint32_t eventcount_prepare_wait(EventCount* ec) {
+#if EVENTCOUNT_TSAN
+    atomic_fetch_add_explicit(&ec->waiters, 1, memory_order_seq_cst);
+#else
+    atomic_fetch_add_explicit(&ec->waiters, 1, memory_order_relaxed);
+    // Pairs with the fence in eventcount_notify (see there)
+    atomic_thread_fence(memory_order_seq_cst);
+#endif
+    return atomic_load_explicit(&ec->epoch, memory_order_acquire);
+}
+
+// Withdraw an announced wait
+void eventcount_cancel_wait(EventCount* ec) {
+    atomic_fetch_sub_explicit(&ec->waiters, 1, memory_order_relaxed);
+}
+
+// Sleep until notified, timed out or woken spuriously
+void eventcount_wait(EventCount* ec, uint32_t key, uint64_t timeout_ns) {
+    if (atomic_load_explicit(&ec->epoch, memory_order_acquire) == key) {
+#if defined(__linux__)
+        struct timespec ts;
+        struct timespec* tsp = NULL;
+        if (timeout_ns != EVENTCOUNT_FOREVER) {
+            ts.tv_sec = (time_t)(timeout_ns / 1000000000u);
+            ts.tv_nsec = (long)(timeout_ns % 1000000000u);
+            tsp = &ts;
+        }
+        // Returns at once if epoch no longer equals key
+        syscall(SYS_futex, (unsigned int*)&ec->epoch, FUTEX_WAIT_PRIVATE, key, tsp, NULL, 0);
+#elif defined(_WIN32)
+        DWORD ms = INFINITE;
+        if (timeout_ns != EVENTCOUNT_FOREVER) {
+            uint64_t rounded = (timeout_ns + 999999u) / 1000000u;
+            ms = rounded >= INFINITE ? INFINITE - 1 : (DWORD)rounded;
+        }
+        WaitOnAddress((volatile VOID*)&ec->epoch, &key, sizeof(key), ms);
+#else
+        EventCountFallback* fb = fallback_get(ec);
+        if (fb != NULL) {
+            pthread_mutex_lock(&fb->mutex);
+            if (atomic_load_explicit(&ec->epoch, memory_order_acquire) == key) {
+                if (timeout_ns == EVENTCOUNT_FOREVER) {
+                    pthread_cond_wait(&fb->cond, &fb->mutex);
+                } else {
+                    struct timespec ts;
+                    clock_gettime(CLOCK_REALTIME, &ts);
+                    uint64_t ns = (uint64_t)ts.tv_nsec + timeout_ns % 1000000000u;
+                    ts.tv_sec += (time_t)(timeout_ns / 1000000000u + ns / 1000000000u);
+                    ts.tv_nsec = (long)(ns % 1000000000u);
+                    pthread_cond_timedwait(&fb->cond, &fb->mutex, &ts);
+                }
+            }
+            pthread_mutex_unlock(&fb->mutex);
+        }
+#endif
+    }
+    atomic_fetch_sub_explicit(&ec->waiters, 1, memory_order_relaxed);
+}
+
+// Wake sleeping waiters
+void eventcount_wake(EventCount* ec, bool all) {
+    atomic_fetch_add_explicit(&ec->epoch, 1, memory_order_release);
+#if defined(__linux__)
+    syscall(SYS_futex, (unsigned int*)&ec->epoch, FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, NULL, NULL, 0);
+#elif defined(_WIN32)
+    if (all) {
+        WakeByAddressAll((PVOID)&ec->epoch);
+    } else {
+        WakeByAddressSingle((PVOID)&ec->epoch);
+    }
+#else
+    EventCountFallback* fb = fallback_get(ec);
+    if (fb != NULL) {
+        pthread_mutex_lock(&fb->mutex);
+        if (all) {
+            pthread_cond_broadcast(&fb->cond);
+        } else {
+            pthread_cond_signal(&fb->cond);
+        }
+        pthread_mutex_unlock(&fb->mutex);
+    }
+#endif
+}
+
+// Monotonic clock in nanoseconds
+uint64_t eventcount_now_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
@@ -0,0 +1,82 @@
+#ifndef EVENTCOUNT_H
+#define EVENTCOUNT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Eventcount: lets threads sleep until a lock-free structure changes
+//
+// A waiter announces itself with eventcount_prepare_wait(), re-checks its
+// condition (e.g. tries to dequeue) and only then parks in eventcount_wait().
+// A notifier changes the structure and then calls eventcount_notify(), which
+// costs one fence and one load while nobody is waiting. The epoch a waiter
+// read in prepare_wait makes the park return at once if a notify slipped in
+// between its check and its sleep, so wakeups cannot be lost.
+//
+// Parking uses futex on Linux and WaitOnAddress on Windows; other systems
+// fall back to a mutex and condition variable.
+
+// ThreadSanitizer does not model fences, so sanitized builds order the
+// handshake with seq_cst read-modify-writes on waiters instead
+#if defined(__SANITIZE_THREAD__)
+#define EVENTCOUNT_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define EVENTCOUNT_TSAN 1
+#endif
+#endif
+#ifndef EVENTCOUNT_TSAN
+#define EVENTCOUNT_TSAN 0
+#endif
+
+// Wait without a time limit
+#define EVENTCOUNT_FOREVER UINT64_MAX
+
+typedef struct EventCount {
+    atomic_uint epoch;         // Bumped by every notify that finds waiters (futex word)
+    atomic_uint waiters;       // Threads between prepare_wait and the end of their wait
+#if !defined(__linux__) && !defined(_WIN32)
+    void* fallback;            // Mutex/condition pair, created on first wait
+#endif
+} EventCount;
+
+// Initialize an eventcount with no waiters
+void eventcount_init(EventCount* ec);
+
+// Release resources held by an eventcount (no thread may be waiting)
+void eventcount_destroy(EventCount* ec);
+
+// Announce an upcoming wait; returns the key to pass to eventcount_wait
+// Must be followed by exactly one eventcount_wait or eventcount_cancel_wait
+uint32_t eventcount_prepare_wait(EventCount* ec);
+
+// Withdraw an announced wait (the condition turned out to be satisfied)
+void eventcount_cancel_wait(EventCount* ec);
+
+// Sleep until a notify after prepare_wait, the timeout or a spurious wakeup
+void eventcount_wait(EventCount* ec, uint32_t key, uint64_t timeout_ns);
+
+// Wake sleeping waiters (slow path of eventcount_notify)
+void eventcount_wake(EventCount* ec, bool all);
+
+// Wake one (or all) waiters if there are any
+// The caller's change to the shared structure must happen before the call
+static inline void eventcount_notify(EventCount* ec, bool all) {
+    // Pairs with the fence in prepare_wait: either we see the waiter, or the
+    // waiter's re-check sees our change
+#if EVENTCOUNT_TSAN
+    unsigned int waiters = atomic_fetch_add_explicit(&ec->waiters, 0, memory_order_seq_cst);
+#else
+    atomic_thread_fence(memory_order_seq_cst);
+    unsigned int waiters = atomic_load_explicit(&ec->waiters, memory_order_relaxed);
+#endif
+    if (waiters != 0) {
+        eventcount_wake(ec, all);
+    }
+}
+
+// Monotonic clock in nanoseconds (for computing deadlines)
+uint64_t eventcount_now_ns(void);
+
+#endif // EVENTCOUNT_H
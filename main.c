@@ -1,229 +1,547 @@
-#define _POSIX_C_SOURCE 200809L
-#include "queue.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <assert.h>
-#include <string.h>
-#include <pthread.h>
-#include <time.h>
-#include <unistd.h>
-
-// Print function for integers
-void print_int(const void* data, size_t length) {
-    if (data != NULL && length == sizeof(int)) {
-        printf("%d", *(const int*)data);
-    } else {
-        printf("(invalid int)");
-    }
-}
-
-// Print function for strings
-void print_string(const void* data, size_t length) {
-    if (data != NULL && length > 0) {
-        printf("\"%.*s\"", (int)length, (const char*)data);
-    } else {
-        printf("(empty)");
-    }
-}
-
-int main(void) {
-    printf("Lock-Free Doubly Linked List Queue Demo\n");
-    printf("========================================\n\n");
-    
-    // Initialize queue
-    Queue* queue = queue_init();
-    if (queue == NULL) {
-        fprintf(stderr, "Failed to initialize queue\n");
-        return 1;
-    }
-    
-    printf("Initial queue state:\n");
-    queue_print(queue, NULL);
-    printf("Is empty: %s\n\n", queue_is_empty(queue) ? "Yes" : "No");
-    
-    // Enqueue integer elements
-    printf("Enqueuing integer elements: 10, 20, 30, 40, 50\n");
-    int values[] = {10, 20, 30, 40, 50};
-    for (int i = 0; i < 5; i++) {
-        assert(queue_enqueue(queue, &values[i], sizeof(int)) == true);
-    }
-    
-    queue_print(queue, print_int);
-    printf("Size: %zu\n", queue_size(queue));
-    printf("Is empty: %s\n\n", queue_is_empty(queue) ? "Yes" : "No");
-    
-    // Dequeue integer elements
-    printf("Dequeuing integer elements:\n");
-    void* dequeued_data;
-    size_t dequeued_length;
-    while (!queue_is_empty(queue)) {
-        if (queue_dequeue(queue, &dequeued_data, &dequeued_length)) {
-            if (dequeued_data != NULL && dequeued_length == sizeof(int)) {
-                int value = *(int*)dequeued_data;
-                printf("  Dequeued: %d (length: %zu bytes)\n", value, dequeued_length);
-                free(dequeued_data);  // Free the data returned by dequeue
-            }
-            queue_print(queue, print_int);
-            printf("  Size: %zu\n\n", queue_size(queue));
-        }
-    }
-    
-    // Test empty queue dequeue
-    printf("Attempting to dequeue from empty queue:\n");
-    bool result = queue_dequeue(queue, &dequeued_data, &dequeued_length);
-    printf("  Result: %s (expected: false)\n\n", result ? "Success" : "Failed (as expected)");
-    
-    // Enqueue string elements
-    printf("Enqueuing string elements:\n");
-    const char* strings[] = {"Hello", "World", "Queue", "Test"};
-    for (int i = 0; i < 4; i++) {
-        size_t str_len = strlen(strings[i]) + 1;  // Include null terminator
-        assert(queue_enqueue(queue, strings[i], str_len) == true);
-        printf("  Enqueued: \"%s\" (length: %zu bytes)\n", strings[i], str_len);
-    }
-    
-    printf("\nQueue contents:\n");
-    queue_print(queue, print_string);
-    printf("Size: %zu\n\n", queue_size(queue));
-    
-    // Dequeue one string
-    printf("Dequeuing one string element:\n");
-    if (queue_dequeue(queue, &dequeued_data, &dequeued_length)) {
-        if (dequeued_data != NULL) {
-            printf("  Dequeued: \"%s\" (length: %zu bytes)\n", (char*)dequeued_data, dequeued_length);
-            free(dequeued_data);  // Free the data
-        }
-        queue_print(queue, print_string);
-        printf("  Size: %zu\n\n", queue_size(queue));
-    }
-    
-    // Enqueue mixed data types
-    printf("Enqueuing mixed data: integer and string\n");
-    int num = 42;
-    queue_enqueue(queue, &num, sizeof(int));
-    const char* msg = "Mixed";
-    queue_enqueue(queue, msg, strlen(msg) + 1);
-    
-    printf("\nQueue with mixed data types:\n");
-    queue_print(queue, NULL);  // NULL print function shows addresses
-    
-    // Dequeue all remaining elements
-    printf("\nDequeuing all remaining elements:\n");
-    while (!queue_is_empty(queue)) {
-        if (queue_dequeue(queue, &dequeued_data, &dequeued_length)) {
-            printf("  Dequeued: ptr=%p, length=%zu bytes\n", dequeued_data, dequeued_length);
-            free(dequeued_data);
-        }
-    }
-    
-    // Clean up
-    queue_destroy(queue);
-    printf("\nQueue destroyed successfully.\n");
-    
-    // Multi-threaded test
-    printf("\n");
-    printf("========================================\n");
-    printf("Multi-Threaded Test\n");
-    printf("========================================\n\n");
-    
-    Queue* test_queue = queue_init();
-    if (test_queue == NULL) {
-        fprintf(stderr, "Failed to initialize test queue\n");
-        return 1;
-    }
-    
-    // Thread argument structure
-    typedef struct {
-        Queue* queue;
-        int thread_id;
-    } ThreadArg;
-    
-    // Thread function that enqueues 100 items, then dequeues them with random waits
-    void* enqueue_thread(void* arg) {
-        ThreadArg* targ = (ThreadArg*)arg;
-        Queue* q = targ->queue;
-        int thread_id = targ->thread_id;
-        
-        // Seed random number generator with thread ID and time
-        unsigned int seed = (unsigned int)(time(NULL) ^ thread_id ^ (unsigned long)pthread_self());
-        
-        // Phase 1: Enqueue 100 items
-        for (int i = 0; i < 100; i++) {
-            // Create data with thread ID and item number
-            int* data = (int*)malloc(sizeof(int));
-            if (data != NULL) {
-                *data = thread_id * 1000 + i;  // Unique value: thread_id * 1000 + item_number
-                queue_enqueue(q, data, sizeof(int));
-                free(data);  // Free local copy (queue makes its own copy)
-            }
-            
-            // Random wait between 0 and 1000 microseconds
-            int wait_us = rand_r(&seed) % 1001;
-            struct timespec ts;
-            ts.tv_sec = 0;
-            ts.tv_nsec = wait_us * 1000;  // Convert microseconds to nanoseconds
-            nanosleep(&ts, NULL);
-        }
-        
-        // Phase 2: Dequeue items (try to dequeue 100 items)
-        for (int i = 0; i < 100; i++) {
-            void* dequeued_data;
-            size_t dequeued_length;
-            
-            // Try to dequeue an item
-            if (queue_dequeue(q, &dequeued_data, &dequeued_length)) {
-                // Successfully dequeued - free the data
-                if (dequeued_data != NULL) {
-                    free(dequeued_data);
-                }
-            }
-            
-            // Random wait between 0 and 1000 microseconds
-            int wait_us = rand_r(&seed) % 1001;
-            struct timespec ts;
-            ts.tv_sec = 0;
-            ts.tv_nsec = wait_us * 1000;  // Convert microseconds to nanoseconds
-            nanosleep(&ts, NULL);
-        }
-        
-        return NULL;
-    }
-    
-    // Create 10 threads
-    const int num_threads = 10;
-    pthread_t threads[num_threads];
-    ThreadArg thread_args[num_threads];
-    
-    printf("Starting %d threads, each adding 100 items then deleting 100 items with random wait times...\n", num_threads);
-    
-    // Create threads
-    for (int i = 0; i < num_threads; i++) {
-        thread_args[i].queue = test_queue;
-        thread_args[i].thread_id = i;
-        if (pthread_create(&threads[i], NULL, enqueue_thread, &thread_args[i]) != 0) {
-            fprintf(stderr, "Failed to create thread %d\n", i);
-            queue_destroy(test_queue);
-            return 1;
-        }
-    }
-    
-    // Wait for all threads to complete
-    printf("Waiting for all threads to complete...\n");
-    for (int i = 0; i < num_threads; i++) {
-        if (pthread_join(threads[i], NULL) != 0) {
-            fprintf(stderr, "Failed to join thread %d\n", i);
-        }
-    }
-    
-    printf("All threads completed.\n\n");
-    
-    // Print stats
-    queue_print_stats(test_queue);
-    
-    // Clean up
-    printf("\nCleaning up test queue...\n");
-    queue_destroy(test_queue);
-    printf("Test queue destroyed successfully.\n");
-    
-    return 0;
-}
+#define _POSIX_C_SOURCE 200809L
+#include "queue.h"
+#include "dispatcher.h"
+#include "engine.h"
+#include "pool.h"
+#include "ring.h"
+#include "shared_queue.h"
+#include "typed_queue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+// Fixed-size element for the typed queue demo
+typedef struct Task {
+    uint32_t id;
+    uint32_t priority;
+    uint64_t deadline;
+} Task;
+
+DEFINE_TYPED_QUEUE(task_queue, Task)
+
+// Print function for integers
+void print_int(const void* data, size_t length) {
+    if (data != NULL && length == sizeof(int)) {
+        printf("%d", *(const int*)data);
+    } else {
+        printf("(invalid int)");
+    }
+}
+
+// Dispatcher handler: add an integer element to a running total
+static void sum_handler(void* data, size_t length, void* ctx) {
+    if (length == sizeof(int)) {
+        atomic_fetch_add_explicit((atomic_long*)ctx, *(const int*)data, memory_order_relaxed);
+    }
+}
+
+// Print function for strings
+void print_string(const void* data, size_t length) {
+    if (data != NULL && length > 0) {
+        printf("\"%.*s\"", (int)length, (const char*)data);
+    } else {
+        printf("(empty)");
+    }
+}
+
+int main(void) {
+    printf("Lock-Free Doubly Linked List Queue Demo\n");
+    printf("========================================\n\n");
+    
+    // Initialize queue
+    Queue* queue = queue_init();
+    if (queue == NULL) {
+        fprintf(stderr, "Failed to initialize queue\n");
+        return 1;
+    }
+    
+    printf("Initial queue state:\n");
+    queue_print(queue, NULL);
+    printf("Is empty: %s\n\n", queue_is_empty(queue) ? "Yes" : "No");
+    
+    // Enqueue integer elements
+    printf("Enqueuing integer elements: 10, 20, 30, 40, 50\n");
+    int values[] = {10, 20, 30, 40, 50};
+    for (int i = 0; i < 5; i++) {
+        assert(queue_enqueue(queue, &values[i], sizeof(int)) == true);
+    }
+    
+    queue_print(queue, print_int);
+    printf("Size: %zu\n", queue_size(queue));
+    printf("Is empty: %s\n\n", queue_is_empty(queue) ? "Yes" : "No");
+    
+    // Dequeue integer elements
+    printf("Dequeuing integer elements:\n");
+    void* dequeued_data;
+    size_t dequeued_length;
+    while (!queue_is_empty(queue)) {
+        if (queue_dequeue(queue, &dequeued_data, &dequeued_length)) {
+            if (dequeued_data != NULL && dequeued_length == sizeof(int)) {
+                int value = *(int*)dequeued_data;
+                printf("  Dequeued: %d (length: %zu bytes)\n", value, dequeued_length);
+                free(dequeued_data);  // Free the data returned by dequeue
+            }
+            queue_print(queue, print_int);
+            printf("  Size: %zu\n\n", queue_size(queue));
+        }
+    }
+    
+    // Test empty queue dequeue
+    printf("Attempting to dequeue from empty queue:\n");
+    bool result = queue_dequeue(queue, &dequeued_data, &dequeued_length);
+    printf("  Result: %s (expected: false)\n\n", result ? "Success" : "Failed (as expected)");
+    
+    // Enqueue string elements
+    printf("Enqueuing string elements:\n");
+    const char* strings[] = {"Hello", "World", "Queue", "Test"};
+    for (int i = 0; i < 4; i++) {
+        size_t str_len = strlen(strings[i]) + 1;  // Include null terminator
+        assert(queue_enqueue(queue, strings[i], str_len) == true);
+        printf("  Enqueued: \"%s\" (length: %zu bytes)\n", strings[i], str_len);
+    }
+    
+    printf("\nQueue contents:\n");
+    queue_print(queue, print_string);
+    printf("Size: %zu\n\n", queue_size(queue));
+    
+    // Dequeue one string
+    printf("Dequeuing one string element:\n");
+    if (queue_dequeue(queue, &dequeued_data, &dequeued_length)) {
+        if (dequeued_data != NULL) {
+            printf("  Dequeued: \"%s\" (length: %zu bytes)\n", (char*)dequeued_data, dequeued_length);
+            free(dequeued_data);  // Free the data
+        }
+        queue_print(queue, print_string);
+        printf("  Size: %zu\n\n", queue_size(queue));
+    }
+    
+    // Enqueue mixed data types
+    printf("Enqueuing mixed data: integer and string\n");
+    int num = 42;
+    queue_enqueue(queue, &num, sizeof(int));
+    const char* msg = "Mixed";
+    queue_enqueue(queue, msg, strlen(msg) + 1);
+    
+    printf("\nQueue with mixed data types:\n");
+    queue_print(queue, NULL);  // NULL print function shows addresses
+    
+    // Dequeue all remaining elements
+    printf("\nDequeuing all remaining elements:\n");
+    while (!queue_is_empty(queue)) {
+        if (queue_dequeue(queue, &dequeued_data, &dequeued_length)) {
+            printf("  Dequeued: ptr=%p, length=%zu bytes\n", dequeued_data, dequeued_length);
+            free(dequeued_data);
+        }
+    }
+    
+    // Clean up
+    queue_destroy(queue);
+    printf("\nQueue destroyed successfully.\n");
+    
+    // Bounded ring buffer
+    printf("\n");
+    printf("========================================\n");
+    printf("Ring Buffer Demo\n");
+    printf("========================================\n\n");
+    
+    RingQueue* ring = ring_init(4);
+    if (ring == NULL) {
+        fprintf(stderr, "Failed to initialize ring\n");
+        return 1;
+    }
+    
+    // The ring stores pointers, so the values must outlive their stay in it
+    printf("Enqueuing into a ring of capacity %zu: 10, 20, 30, 40, 50\n", ring_capacity(ring));
+    for (int i = 0; i < 5; i++) {
+        bool accepted = ring_try_enqueue(ring, &values[i], sizeof(int));
+        printf("  %d: %s\n", values[i], accepted ? "accepted" : "rejected (ring full)");
+    }
+    printf("Size: %zu\n", ring_size(ring));
+    
+    printf("Dequeuing:\n");
+    while (ring_try_dequeue(ring, &dequeued_data, &dequeued_length)) {
+        printf("  Dequeued: %d\n", *(int*)dequeued_data);
+    }
+    ring_destroy(ring);
+    printf("Ring destroyed successfully.\n");
+    
+    // Multi-threaded test
+    printf("\n");
+    printf("========================================\n");
+    printf("Multi-Threaded Test\n");
+    printf("========================================\n\n");
+    
+    Queue* test_queue = queue_init();
+    if (test_queue == NULL) {
+        fprintf(stderr, "Failed to initialize test queue\n");
+        return 1;
+    }
+    
+    // Back off adaptively when the worker threads collide
+    BackoffConfig backoff = backoff_config_default(BACKOFF_ADAPTIVE);
+    queue_set_backoff(test_queue, &backoff);
+    
+    // Thread argument structure
+    typedef struct {
+        Queue* queue;
+        int thread_id;
+    } ThreadArg;
+    
+    // Thread function that enqueues 100 items, then dequeues them with random waits
+    void* enqueue_thread(void* arg) {
+        ThreadArg* targ = (ThreadArg*)arg;
+        Queue* q = targ->queue;
+        int thread_id = targ->thread_id;
+        
+        // Seed random number generator with thread ID and time
+        unsigned int seed = (unsigned int)(time(NULL) ^ thread_id ^ (unsigned long)pthread_self());
+        
+        // Phase 1: Enqueue 100 items
+        for (int i = 0; i < 100; i++) {
+            // Create data with thread ID and item number
+            int* data = (int*)malloc(sizeof(int));
+            if (data != NULL) {
+                *data = thread_id * 1000 + i;  // Unique value: thread_id * 1000 + item_number
+                if (!queue_enqueue_owned(q, data, sizeof(int))) {
+                    free(data);  // Ownership only passes to the queue on success
+                }
+            }
+            
+            // Random wait between 0 and 1000 microseconds
+            int wait_us = rand_r(&seed) % 1001;
+            struct timespec ts;
+            ts.tv_sec = 0;
+            ts.tv_nsec = wait_us * 1000;  // Convert microseconds to nanoseconds
+            nanosleep(&ts, NULL);
+        }
+        
+        // Phase 2: Dequeue items (try to dequeue 100 items)
+        for (int i = 0; i < 100; i++) {
+            void* dequeued_data;
+            size_t dequeued_length;
+            
+            // Try to dequeue an item
+            if (queue_dequeue(q, &dequeued_data, &dequeued_length)) {
+                // Successfully dequeued - free the data
+                if (dequeued_data != NULL) {
+                    free(dequeued_data);
+                }
+            }
+            
+            // Random wait between 0 and 1000 microseconds
+            int wait_us = rand_r(&seed) % 1001;
+            struct timespec ts;
+            ts.tv_sec = 0;
+            ts.tv_nsec = wait_us * 1000;  // Convert microseconds to nanoseconds
+            nanosleep(&ts, NULL);
+        }
+        
+        return NULL;
+    }
+    
+    // Create 10 threads
+    const int num_threads = 10;
+    pthread_t threads[num_threads];
+    ThreadArg thread_args[num_threads];
+    
+    printf("Starting %d threads, each adding 100 items then deleting 100 items with random wait times...\n", num_threads);
+    
+    // Create threads
+    for (int i = 0; i < num_threads; i++) {
+        thread_args[i].queue = test_queue;
+        thread_args[i].thread_id = i;
+        if (pthread_create(&threads[i], NULL, enqueue_thread, &thread_args[i]) != 0) {
+            fprintf(stderr, "Failed to create thread %d\n", i);
+            queue_destroy(test_queue);
+            return 1;
+        }
+    }
+    
+    // Wait for all threads to complete
+    printf("Waiting for all threads to complete...\n");
+    for (int i = 0; i < num_threads; i++) {
+        if (pthread_join(threads[i], NULL) != 0) {
+            fprintf(stderr, "Failed to join thread %d\n", i);
+        }
+    }
+    
+    printf("All threads completed.\n\n");
+    
+    // Print stats
+    queue_print_stats(test_queue);
+    
+    // Clean up
+    printf("\nCleaning up test queue...\n");
+    queue_destroy(test_queue);
+    printf("Test queue destroyed successfully.\n");
+    
+    // Blocking dequeue demo
+    printf("\n");
+    printf("========================================\n");
+    printf("Blocking Dequeue Demo\n");
+    printf("========================================\n\n");
+    
+    Queue* wait_queue = queue_init();
+    if (wait_queue == NULL) {
+        fprintf(stderr, "Failed to initialize wait queue\n");
+        return 1;
+    }
+    
+    // Consumer that sleeps in queue_dequeue_wait instead of polling
+    void* waiting_consumer(void* arg) {
+        Queue* q = (Queue*)arg;
+        while (true) {
+            void* data;
+            size_t length;
+            QueueWaitStatus status = queue_dequeue_wait(q, &data, &length, 1000000000ull);
+            if (status == QUEUE_WAIT_OK) {
+                printf("Consumer woke up with %d\n", *(int*)data);
+                free(data);
+            } else {
+                printf(status == QUEUE_WAIT_CLOSED ? "Consumer saw the queue closed\n" : "Consumer timed out\n");
+                break;
+            }
+        }
+        return NULL;
+    }
+    
+    pthread_t consumer;
+    if (pthread_create(&consumer, NULL, waiting_consumer, wait_queue) != 0) {
+        fprintf(stderr, "Failed to create consumer thread\n");
+        queue_destroy(wait_queue);
+        return 1;
+    }
+    
+    for (int i = 1; i <= 5; i++) {
+        struct timespec ts = { 0, 20 * 1000000L };  // 20 ms between elements
+        nanosleep(&ts, NULL);
+        queue_enqueue(wait_queue, &i, sizeof(int));
+    }
+    
+    // No more data: consumers drain what is left, then get QUEUE_WAIT_CLOSED
+    queue_close(wait_queue);
+    pthread_join(consumer, NULL);
+    int late = 6;
+    printf("Enqueue after close: %s\n", queue_enqueue(wait_queue, &late, sizeof(int)) ? "accepted" : "rejected");
+    
+    queue_destroy(wait_queue);
+    printf("Wait queue destroyed successfully.\n");
+    
+    // Priority queue demo
+    printf("\n");
+    printf("========================================\n");
+    printf("Priority Queue Demo\n");
+    printf("========================================\n\n");
+    
+    Queue* priority_queue = queue_init_mode(QUEUE_MODE_PRIORITY);
+    if (priority_queue == NULL) {
+        fprintf(stderr, "Failed to initialize priority queue\n");
+        return 1;
+    }
+    
+    // Bulk data goes to the lowest level; control messages jump ahead of it
+    for (int i = 1; i <= 3; i++) {
+        queue_enqueue(priority_queue, &i, sizeof(int));
+    }
+    int control = 100;
+    queue_enqueue_priority(priority_queue, &control, sizeof(int), QUEUE_PRIORITY_HIGHEST);
+    
+    printf("Priority queue contents: ");
+    queue_print(priority_queue, print_int);
+    
+    void* priority_data;
+    size_t priority_length;
+    while (queue_dequeue(priority_queue, &priority_data, &priority_length)) {
+        printf("Dequeued: %d\n", *(int*)priority_data);
+        free(priority_data);
+    }
+    
+    queue_destroy(priority_queue);
+    printf("Priority queue destroyed successfully.\n");
+    
+    // Shared-memory queue demo
+    printf("\n");
+    printf("========================================\n");
+    printf("Shared Memory Queue Demo\n");
+    printf("========================================\n\n");
+    
+    // A second process would call queue_attach with the same name; a second
+    // handle in this process goes through the same mapping
+    char shared_name[64];
+    snprintf(shared_name, sizeof(shared_name), "/queue_demo_%ld", (long)getpid());
+    SharedQueue* shared_producer = queue_create_shared(shared_name, 16);
+    SharedQueue* shared_consumer = queue_attach(shared_name);
+    if (shared_producer == NULL || shared_consumer == NULL) {
+        fprintf(stderr, "Failed to set up shared queue\n");
+        shared_queue_detach(shared_producer);
+        shared_queue_unlink(shared_name);
+        return 1;
+    }
+    
+    const char* messages[] = { "hello", "from", "shared memory" };
+    for (int i = 0; i < 3; i++) {
+        shared_queue_enqueue(shared_producer, messages[i], strlen(messages[i]) + 1);
+    }
+    printf("Shared queue size: %zu of %zu slots\n",
+           shared_queue_size(shared_consumer), shared_queue_capacity(shared_consumer));
+    
+    SharedQueueSlot shared_slot;
+    while (shared_queue_acquire(shared_consumer, &shared_slot)) {
+        printf("Dequeued: %s\n", (const char*)shared_slot.data);
+        shared_queue_release(shared_consumer, &shared_slot);
+    }
+    
+    shared_queue_detach(shared_consumer);
+    shared_queue_detach(shared_producer);
+    shared_queue_unlink(shared_name);
+    printf("Shared queue destroyed successfully.\n");
+    
+    // Typed queue demo
+    printf("\n");
+    printf("========================================\n");
+    printf("Typed Queue Demo\n");
+    printf("========================================\n\n");
+    
+    task_queue* tasks = task_queue_init(8);
+    if (tasks == NULL) {
+        fprintf(stderr, "Failed to initialize typed queue\n");
+        return 1;
+    }
+    for (uint32_t i = 1; i <= 3; i++) {
+        task_queue_try_enqueue(tasks, (Task){ i, 10 * i, 1000 * (uint64_t)i });
+    }
+    printf("Typed queue size: %zu of %zu slots (%zu-byte elements)\n",
+           task_queue_size(tasks), task_queue_capacity(tasks), sizeof(Task));
+    
+    Task task;
+    while (task_queue_try_dequeue(tasks, &task)) {
+        printf("Dequeued task %u (priority %u, deadline %llu)\n",
+               task.id, task.priority, (unsigned long long)task.deadline);
+    }
+    
+    task_queue_destroy(tasks);
+    printf("Typed queue destroyed successfully.\n");
+    
+    // Dispatcher demo
+    printf("\n");
+    printf("========================================\n");
+    printf("Dispatcher Demo\n");
+    printf("========================================\n\n");
+    
+    Queue* work_queue = queue_init();
+    atomic_long work_sum;
+    atomic_init(&work_sum, 0);
+    QueueDispatcher* dispatcher = work_queue != NULL ? dispatcher_start(work_queue, 2, sum_handler, &work_sum) : NULL;
+    if (dispatcher == NULL) {
+        fprintf(stderr, "Failed to start dispatcher\n");
+        queue_destroy(work_queue);
+        return 1;
+    }
+    
+    for (int i = 1; i <= 1000; i++) {
+        queue_enqueue(work_queue, &i, sizeof(int));
+    }
+    printf("Enqueued 1..1000 for 2 dispatcher workers\n");
+    
+    dispatcher_stop(dispatcher, true);  // Drain what is still queued, then join
+    printf("Sum after drain: %ld (expected: 500500)\n", atomic_load(&work_sum));
+    printf("Queue empty after drain: %s\n", queue_is_empty(work_queue) ? "Yes" : "No");
+    
+    queue_destroy(work_queue);
+    printf("Dispatcher stopped successfully.\n");
+    
+    // Engine front end demo
+    printf("\n");
+    printf("========================================\n");
+    printf("Engine Front End Demo\n");
+    printf("========================================\n\n");
+    
+    QueueConfig events_config = queue_config_default();
+    events_config.blocking = true;
+    QueueConfig ticks_config = queue_config_default();
+    ticks_config.capacity = 1000;
+    ticks_config.element_size = sizeof(uint64_t);
+    QueueHandle* events = queue_create(&events_config);
+    QueueHandle* ticks = queue_create(&ticks_config);
+    if (events == NULL || ticks == NULL) {
+        fprintf(stderr, "Failed to create channels\n");
+        queue_handle_destroy(events);
+        queue_handle_destroy(ticks);
+        return 1;
+    }
+    printf("Unbounded blocking channel: %s engine\n", queue_handle_engine(events));
+    printf("Bounded fixed-size channel: %s engine\n", queue_handle_engine(ticks));
+    
+    for (uint64_t tick = 0; tick < 5; tick++) {
+        queue_handle_enqueue(ticks, &tick, sizeof(tick));
+    }
+    const char* event = "tick";
+    queue_handle_enqueue(events, event, strlen(event) + 1);
+    printf("Wrong-size element rejected: %s\n", !queue_handle_enqueue(ticks, event, strlen(event) + 1) ? "Yes" : "No");
+    printf("Channel sizes: %zu and %zu\n", queue_handle_size(events), queue_handle_size(ticks));
+    
+    uint64_t tick_sum = 0;
+    uint64_t tick;
+    size_t tick_length;
+    while (queue_handle_dequeue_into(ticks, &tick, sizeof(tick), &tick_length)) {
+        tick_sum += tick;
+    }
+    void* event_data;
+    size_t event_length;
+    if (queue_handle_dequeue_wait(events, &event_data, &event_length, QUEUE_WAIT_FOREVER) == QUEUE_WAIT_OK) {
+        printf("Event: %s, tick sum: %llu\n", (char*)event_data, (unsigned long long)tick_sum);
+        free(event_data);
+    }
+    
+    queue_handle_destroy(events);
+    queue_handle_destroy(ticks);
+    printf("Channels destroyed successfully.\n");
+    
+    // Huge page demo
+    printf("\n");
+    printf("========================================\n");
+    printf("Huge Page Demo\n");
+    printf("========================================\n\n");
+    
+    node_pool_set_huge_pages(true);
+    Queue* huge_queue = queue_init_with_pool(10000);  // Nodes mapped from huge pages and prefaulted
+    node_pool_set_huge_pages(false);
+    RingQueue* huge_ring = ring_init_huge(1 << 16);
+    if (huge_queue == NULL || huge_ring == NULL) {
+        fprintf(stderr, "Failed to create huge-page queues\n");
+        queue_destroy(huge_queue);
+        ring_destroy(huge_ring);
+        return 1;
+    }
+    printf("Huge page size: %zu KB, ring slots: %zu\n", (size_t)QUEUE_HUGE_PAGE_SIZE / 1024, ring_capacity(huge_ring));
+    
+    for (int i = 0; i < 10000; i++) {
+        queue_enqueue(huge_queue, &i, sizeof(int));
+    }
+    size_t huge_count = 0;
+    int huge_value;
+    size_t huge_length;
+    while (queue_dequeue_into(huge_queue, &huge_value, sizeof(huge_value), &huge_length)) {
+        ring_try_enqueue(huge_ring, (void*)(uintptr_t)(huge_value + 1), 0);  // Value carried in the pointer
+        huge_count++;
+    }
+    printf("Moved %zu elements from the pooled queue to the ring (ring size: %zu)\n", huge_count,
+           ring_size(huge_ring));
+    
+    long huge_sum = 0;
+    void* huge_item;
+    while (ring_try_dequeue(huge_ring, &huge_item, &huge_length)) {
+        huge_sum += (long)(uintptr_t)huge_item - 1;
+    }
+    printf("Sum drained from the ring: %ld (expected: 49995000)\n", huge_sum);
+    
+    ring_destroy(huge_ring);
+    queue_destroy(huge_queue);
+    printf("Huge-page queues destroyed successfully.\n");
+    
+    return 0;
+}
@@ -0,0 +1,322 @@
+#include "pool.h"
+#include "queue_mem.h"
+#include "reclaim.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+// Free nodes are chained through their payload pointer while they sit in a cache
+// or batch; the atomic next field links batches on the global stack (a stale
+// reader may load it concurrently with the node's next owner)
+static inline Node* chain_next(const Node* node) {
+    return (Node*)node->payload.data;
+}
+
+static inline void chain_set_next(Node* node, Node* next) {
+    node->payload.data = next;
+}
+
+// Slab header; nodes follow it (padded out to the node alignment) and are
+// never freed individually
+typedef struct PoolSlab {
+    struct PoolSlab* next;
+    Node nodes[];
+} PoolSlab;
+
+// Per-thread cache of free nodes
+typedef struct PoolCache {
+    Node* head;
+    size_t count;
+} PoolCache;
+
+// One pool per placement: NODE_POOL_DEFAULT for unbound queues, 1 + n for NUMA node n
+// Each keeps its own global stack, so a node always returns to the pool it came from
+typedef struct NodePool {
+#if QUEUE_TAGGED_MODE != QUEUE_TAGGED_NONE
+    _Alignas(QUEUE_CACHELINE) AtomicPointerWithABA top;  // Stack of batches (linked through node->next)
+#else
+    _Alignas(QUEUE_CACHELINE) _Atomic(Node*) top;  // Stack of batches (linked through node->next)
+#endif
+    _Atomic(PoolSlab*) slabs;  // Every slab ever allocated (keeps them reachable)
+} NodePool;
+
+static NodePool pools[NODE_POOL_COUNT];
+
+static atomic_bool huge_slabs = false;  // Set by node_pool_set_huge_pages
+
+static _Thread_local PoolCache local_cache[NODE_POOL_COUNT];
+static _Thread_local bool cache_registered = false;
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+// Pool a node belongs to (recorded in its flags when its slab was carved up)
+static inline unsigned int pool_of(const Node* node) {
+    return (node->flags & NODE_POOL_MASK) >> NODE_POOL_SHIFT;
+}
+
+// Pool index for a NUMA node (-1: the default pool), NODE_POOL_COUNT if out of range
+static inline unsigned int pool_index(int numa_node) {
+    if (numa_node < -1 || numa_node >= QUEUE_NUMA_MAX_NODES) {
+        return NODE_POOL_COUNT;
+    }
+    return (unsigned int)(numa_node + 1);
+}
+
+#if QUEUE_TAGGED_MODE != QUEUE_TAGGED_NONE
+
+// The global stacks use tagged pointers (see tagged.h): a pop whose top was
+// popped and pushed again in the meantime fails its CAS, so batches go back
+// to the stack immediately. Slabs are never freed, which keeps the stale
+// next load of such a pop safe.
+
+// Push a chain of count nodes (linked through their payload pointers) onto a pool's global stack
+static void global_push(NodePool* pool, Node* batch, size_t count) {
+    batch->length = (uint32_t)count;
+    PointerWithABA top = tagged_load(&pool->top);
+    do {
+        atomic_store_explicit(&batch->next, top.ptr, memory_order_relaxed);
+    } while (!tagged_compare_exchange(&pool->top, &top, batch));
+}
+
+// Pop a batch from a pool's global stack (NULL if it is empty)
+static Node* global_pop(NodePool* pool) {
+    PointerWithABA top = tagged_load(&pool->top);
+    while (top.ptr != NULL) {
+        Node* next = atomic_load_explicit(&top.ptr->next, memory_order_relaxed);
+        if (tagged_compare_exchange(&pool->top, &top, next)) {
+            break;
+        }
+    }
+    return top.ptr;
+}
+
+// Hand a batch leaving a thread cache back to its pool
+static void batch_release(Node* batch) {
+    global_push(&pools[pool_of(batch)], batch, batch->length);
+}
+
+#else
+
+// Without tagged pointers the global stacks rely on epoch-based reclamation:
+// a batch returns to the stack only after a grace period, so no pop can
+// still be holding it as its expected top.
+
+// Push a chain of count nodes (linked through their payload pointers) onto a pool's global stack
+// Only nodes that no concurrent pop can still be looking at may be pushed
+static void global_push(NodePool* pool, Node* batch, size_t count) {
+    batch->length = (uint32_t)count;
+    Node* top = atomic_load_explicit(&pool->top, memory_order_relaxed);
+    do {
+        atomic_store_explicit(&batch->next, top, memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak_explicit(&pool->top, &top, batch,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+
+// Pop a batch from a pool's global stack (NULL if it is empty)
+static Node* global_pop(NodePool* pool) {
+    // A batch is only pushed back after a grace period, so while we are in a
+    // critical section the top we loaded cannot be popped and pushed again
+    reclaim_enter();
+    Node* top = atomic_load_explicit(&pool->top, memory_order_acquire);
+    while (top != NULL) {
+        Node* next = atomic_load_explicit(&top->next, memory_order_relaxed);
+        if (atomic_compare_exchange_weak_explicit(&pool->top, &top, next,
+                                                  memory_order_acquire,
+                                                  memory_order_acquire)) {
+            break;
+        }
+    }
+    reclaim_exit();
+    return top;
+}
+
+// Reclamation callback for a batch leaving a thread cache
+static void batch_reclaim(void* ptr) {
+    Node* batch = (Node*)ptr;
+    global_push(&pools[pool_of(batch)], batch, batch->length);
+}
+
+// Hand a batch leaving a thread cache back to its pool after a grace period
+static void batch_release(Node* batch) {
+    reclaim_retire(batch, batch_reclaim);
+}
+
+#endif
+
+// Allocate a slab for pool index; the first batch goes to the caller, the rest to the global stack
+// *total (if not NULL) receives the number of nodes in the slab. Slabs of a NUMA pool are placed on its node. Huge-page slabs fill whole huge
+// pages with nodes and fall back to an ordinary slab if they cannot be mapped.
+static Node* slab_create(unsigned int index, size_t* count, size_t* total) {
+    NodePool* pool = &pools[index];
+    size_t nodes = NODE_POOL_SLAB_NODES;
+    size_t bytes = sizeof(PoolSlab) + nodes * sizeof(Node);
+    PoolSlab* slab = NULL;
+    if (atomic_load_explicit(&huge_slabs, memory_order_relaxed)) {
+        size_t huge_bytes = queue_mem_huge_size(bytes);
+        slab = (PoolSlab*)queue_mem_alloc_huge(huge_bytes, (int)index - 1);
+        if (slab != NULL) {
+            nodes = (huge_bytes - sizeof(PoolSlab)) / sizeof(Node);
+        }
+    }
+    if (slab == NULL) {
+        slab = (index == NODE_POOL_DEFAULT)
+               ? (PoolSlab*)queue_mem_alloc_aligned(_Alignof(PoolSlab), bytes)
+               : (PoolSlab*)queue_mem_alloc_on_node(bytes, (int)index - 1);
+    }
+    if (slab == NULL) {
+        return NULL;
+    }
+    
+    PoolSlab* head = atomic_load_explicit(&pool->slabs, memory_order_relaxed);
+    do {
+        slab->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->slabs, &head, slab,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+    
+    // Chain every node, then cut the chain into batches
+    for (size_t i = 0; i < nodes; i++) {
+#ifndef QUEUE_SINGLY_LINKED
+        atomic_init(&slab->nodes[i].prev, (Node*)NULL);
+#endif
+        atomic_init(&slab->nodes[i].next, (Node*)NULL);
+        slab->nodes[i].flags = index << NODE_POOL_SHIFT;
+        chain_set_next(&slab->nodes[i], (i + 1 < nodes) ? &slab->nodes[i + 1] : NULL);
+    }
+    for (size_t i = NODE_POOL_BATCH; i < nodes; i += NODE_POOL_BATCH) {
+        chain_set_next(&slab->nodes[i - 1], NULL);
+    }
+    for (size_t i = NODE_POOL_BATCH; i < nodes; i += NODE_POOL_BATCH) {
+        size_t n = nodes - i < NODE_POOL_BATCH ? nodes - i : NODE_POOL_BATCH;
+        global_push(pool, &slab->nodes[i], n);  // Fresh nodes have never been visible to a pop
+    }
+    
+    *count = nodes < NODE_POOL_BATCH ? nodes : NODE_POOL_BATCH;
+    if (total != NULL) {
+        *total = nodes;
+    }
+    return &slab->nodes[0];
+}
+
+// Thread exit: return the cached nodes to their global stacks
+static void cache_release(void* arg) {
+    (void)arg;
+    for (size_t i = 0; i < NODE_POOL_COUNT; i++) {
+        PoolCache* cache = &local_cache[i];
+        if (cache->head != NULL) {
+            cache->head->length = (uint32_t)cache->count;
+            batch_release(cache->head);
+            cache->head = NULL;
+            cache->count = 0;
+        }
+    }
+    cache_registered = false;
+}
+
+static void cache_key_create(void) {
+    pthread_key_create(&cache_key, cache_release);
+}
+
+// Make sure the calling thread's cache is handed back when it exits
+static void cache_register(void) {
+    pthread_once(&cache_key_once, cache_key_create);
+    pthread_setspecific(cache_key, local_cache);
+    cache_registered = true;
+}
+
+// Preallocate nodes into the default pool's global stack
+bool node_pool_reserve(size_t count) {
+    return node_pool_reserve_on(-1, count);
+}
+
+// Preallocate nodes into the global stack of the pool for numa_node
+bool node_pool_reserve_on(int numa_node, size_t count) {
+    unsigned int index = pool_index(numa_node);
+    if (index == NODE_POOL_COUNT) {
+        return false;
+    }
+    size_t reserved = 0;
+    while (reserved < count) {
+        size_t n;
+        size_t total;
+        Node* batch = slab_create(index, &n, &total);
+        if (batch == NULL) {
+            return false;
+        }
+        global_push(&pools[index], batch, n);
+        reserved += total;
+    }
+    return true;
+}
+
+// Carve later slabs out of huge pages (see queue_mem.h)
+// Slabs already allocated keep their pages
+void node_pool_set_huge_pages(bool enable) {
+    atomic_store_explicit(&huge_slabs, enable, memory_order_relaxed);
+}
+
+// Allocate a node from the default pool
+Node* node_pool_alloc(void) {
+    return node_pool_alloc_on(-1);
+}
+
+// Allocate a node from the pool for numa_node
+Node* node_pool_alloc_on(int numa_node) {
+    unsigned int index = pool_index(numa_node);
+    if (index == NODE_POOL_COUNT) {
+        return NULL;
+    }
+    PoolCache* cache = &local_cache[index];
+    
+    if (cache->head == NULL) {
+        Node* batch = global_pop(&pools[index]);
+        size_t count;
+        if (batch != NULL) {
+            count = batch->length;
+        } else {
+            batch = slab_create(index, &count, NULL);
+            if (batch == NULL) {
+                return NULL;
+            }
+        }
+        
+        if (!cache_registered) {
+            cache_register();
+        }
+        cache->head = batch;
+        cache->count = count;
+    }
+    
+    Node* node = cache->head;
+    cache->head = chain_next(node);
+    cache->count--;
+    return node;
+}
+
+// Free a node into the calling thread's cache for the pool it came from
+void node_pool_free(Node* node) {
+    PoolCache* cache = &local_cache[pool_of(node)];
+    if (!cache_registered) {
+        cache_register();
+    }
+    
+    chain_set_next(node, cache->head);
+    cache->head = node;
+    cache->count++;
+    
+    if (cache->count >= 2 * NODE_POOL_BATCH) {
+        // Hand a full batch back to the global stack
+        Node* batch = cache->head;
+        Node* last = batch;
+        for (size_t i = 1; i < NODE_POOL_BATCH; i++) {
+            last = chain_next(last);
+        }
+        cache->head = chain_next(last);
+        cache->count -= NODE_POOL_BATCH;
+        chain_set_next(last, NULL);
+        batch->length = NODE_POOL_BATCH;
+        batch_release(batch);
+    }
+}
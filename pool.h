@@ -0,0 +1,60 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "queue.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Node pool
+//
+// Nodes are carved out of slabs and recycled instead of going back to malloc.
+// Each thread keeps a small private cache of free nodes; when it runs dry it
+// takes a whole batch from a lock-free global stack, and when it overflows it
+// hands a batch back. The global stack is a tagged pointer (see tagged.h),
+// which keeps it free of ABA, so returned batches are reusable at once; where
+// no tagged CAS is available they first pass through epoch-based reclamation
+// instead. Slabs are never returned to the system.
+//
+// Besides the default pool there is one pool per NUMA node whose slabs are
+// placed on that node (see queue_mem.h). Every node remembers its pool in its
+// flags, so node_pool_free always returns it to the pool it came from, even
+// when a thread on another node frees it.
+
+// Nodes handed between a thread cache and the global stack at a time
+#define NODE_POOL_BATCH 64
+
+// Nodes allocated per slab when the pool has to grow
+#define NODE_POOL_SLAB_NODES 256
+
+// Pool used by queues that are not bound to a NUMA node
+#define NODE_POOL_DEFAULT 0
+
+// Number of pools (the default pool plus one per NUMA node)
+#define NODE_POOL_COUNT (1 + QUEUE_NUMA_MAX_NODES)
+
+// Preallocate at least count nodes into the default pool's global stack
+bool node_pool_reserve(size_t count);
+
+// Preallocate at least count nodes placed on numa_node (-1: the default pool)
+bool node_pool_reserve_on(int numa_node, size_t count);
+
+// Carve later slabs out of huge pages (see queue_mem.h) instead of malloc
+// Each such slab fills whole huge pages and is prefaulted, so with
+// node_pool_reserve the nodes a queue starts with cost no TLB misses or page
+// faults. Slabs already allocated keep their pages.
+void node_pool_set_huge_pages(bool enable);
+
+// Take a node from the calling thread's cache (refilling it if needed)
+// Returns NULL only if the pool cannot grow
+Node* node_pool_alloc(void);
+
+// Take a node placed on numa_node (-1: the default pool)
+// Returns NULL if the pool cannot grow or numa_node is out of range
+Node* node_pool_alloc_on(int numa_node);
+
+// Return a node to the calling thread's cache
+// The node must no longer be reachable by other threads (e.g. it was
+// retired through reclaim_retire and its grace period has expired)
+void node_pool_free(Node* node);
+
+#endif // POOL_H
@@ -1,288 +1,2369 @@
-#include "queue.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-
-// Allocate and initialize a new node
-static Node* node_create(const void* data, size_t length) {
-    Node* node = (Node*)malloc(sizeof(Node));
-    if (node == NULL) {
-        return NULL;
-    }
-    
-    // Allocate memory for the data and copy it
-    if (data != NULL && length > 0) {
-        node->data = malloc(length);
-        if (node->data == NULL) {
-            free(node);
-            return NULL;
-        }
-        memcpy(node->data, data, length);
-        node->length = length;
-    } else {
-        node->data = NULL;
-        node->length = 0;
-    }
-    
-    // Initialize prev and next with NULL pointer (plain atomic pointers, no ABA protection on Cygwin)
-    atomic_init(&node->prev, (Node*)NULL);
-    atomic_init(&node->next, (Node*)NULL);
-    return node;
-}
-
-// Free node and its data
-static void node_destroy(Node* node) {
-    if (node != NULL) {
-        if (node->data != NULL) {
-            free(node->data);
-        }
-        free(node);
-    }
-}
-
-// Initialize an empty queue with sentinel nodes
-Queue* queue_init(void) {
-    Queue* queue = (Queue*)malloc(sizeof(Queue));
-    if (queue == NULL) {
-        return NULL;
-    }
-    
-    // Create sentinel head node (no data)
-    Node* head = node_create(NULL, 0);
-    if (head == NULL) {
-        free(queue);
-        return NULL;
-    }
-    
-    // Create sentinel tail node (no data)
-    Node* tail = node_create(NULL, 0);
-    if (tail == NULL) {
-        node_destroy(head);
-        free(queue);
-        return NULL;
-    }
-    
-    // Link sentinel nodes using atomic stores (plain atomic pointers, no ABA protection on Cygwin)
-    atomic_store_explicit(&head->prev, (Node*)NULL, memory_order_release);
-    atomic_store_explicit(&head->next, tail, memory_order_release);
-    atomic_store_explicit(&tail->prev, head, memory_order_release);
-    atomic_store_explicit(&tail->next, (Node*)NULL, memory_order_release);
-    
-    queue->head = head;
-    queue->tail = tail;
-    atomic_init(&queue->size, 0);
-    atomic_init(&queue->enqueue_counter, 0);
-    atomic_init(&queue->dequeue_counter, 0);
-    atomic_init(&queue->enqueue_retries, 0);
-    atomic_init(&queue->dequeue_retries, 0);
-    
-    return queue;
-}
-
-// Destroy queue and free all memory
-void queue_destroy(Queue* queue) {
-    if (queue == NULL) {
-        return;
-    }
-    
-    // Dequeue all remaining nodes
-    void* dummy_data;
-    size_t dummy_length;
-    while (!queue_is_empty(queue)) {
-        if (queue_dequeue(queue, &dummy_data, &dummy_length)) {
-            // Data was already freed in dequeue
-        }
-    }
-    
-    // Free sentinel nodes
-    if (queue->head != NULL) {
-        node_destroy(queue->head);
-    }
-    if (queue->tail != NULL && queue->tail != queue->head) {
-        node_destroy(queue->tail);
-    }
-    
-    free(queue);
-}
-
-// Enqueue an element at the tail (lock-free with retry, no ABA protection on Cygwin)
-bool queue_enqueue(Queue* queue, const void* data, size_t length) {
-    if (queue == NULL) {
-        return false;
-    }
-    
-    if (data == NULL && length > 0) {
-        return false;  // Invalid: data is NULL but length > 0
-    }
-    
-    Node* new_node = node_create(data, length);
-    if (new_node == NULL) {
-        return false;
-    }
-    
-    Node* tail = queue->tail;
-    
-    // Lock-free insertion with retry loop
-    // Since we use sentinel nodes, we insert before the tail sentinel
-    while (true) {
-        // Load tail->prev (plain atomic pointer)
-        Node* prev_tail = atomic_load_explicit(&tail->prev, memory_order_acquire);
-        
-        // Set up new node's links (local writes, not yet visible to other threads)
-        atomic_store_explicit(&new_node->next, tail, memory_order_relaxed);
-        atomic_store_explicit(&new_node->prev, prev_tail, memory_order_relaxed);
-        
-        // Memory barrier: ensure new_node's fields are written before making it visible
-        atomic_thread_fence(memory_order_release);
-        
-        // Atomically update previous node's next pointer to point to new_node
-        // Use compare-and-swap (plain pointer comparison, no ABA protection on Cygwin)
-        Node* expected_next = tail;
-        if (atomic_compare_exchange_strong_explicit(&prev_tail->next, &expected_next, 
-                                                    new_node,
-                                                    memory_order_release,
-                                                    memory_order_acquire)) {
-            // Successfully updated prev_tail->next
-            // Now update tail->prev
-            atomic_store_explicit(&tail->prev, new_node, memory_order_release);
-            atomic_fetch_add_explicit(&queue->size, 1, memory_order_relaxed);
-            
-            // Increment enqueue counter - element has been successfully added to the queue
-            atomic_fetch_add_explicit(&queue->enqueue_counter, 1, memory_order_relaxed);
-            return true;
-        }
-        
-        // CAS failed - another thread modified prev_tail->next, retry
-        // This is the key to lock-freedom: we retry instead of blocking
-        // Increment retry counter
-        atomic_fetch_add_explicit(&queue->enqueue_retries, 1, memory_order_relaxed);
-    }
-}
-
-// Dequeue an element from the head (lock-free with retry, no ABA protection on Cygwin)
-bool queue_dequeue(Queue* queue, void** data, size_t* length) {
-    if (queue == NULL || data == NULL || length == NULL) {
-        return false;
-    }
-    
-    Node* head = queue->head;
-    
-    // Lock-free dequeue with retry loop
-    while (true) {
-        // Load head->next (plain atomic pointer)
-        Node* first_node = atomic_load_explicit(&head->next, memory_order_acquire);
-        
-        // Check if queue is empty (first_node is tail sentinel)
-        if (first_node == queue->tail) {
-            return false;
-        }
-        
-        // Get the next node (plain atomic pointer)
-        Node* next_node = atomic_load_explicit(&first_node->next, memory_order_acquire);
-        
-        // Try to atomically update head->next using CAS (plain pointer comparison, no ABA protection on Cygwin)
-        Node* expected = first_node;
-        if (atomic_compare_exchange_strong_explicit(&head->next, &expected, next_node,
-                                                    memory_order_release,
-                                                    memory_order_acquire)) {
-            // Successfully updated head->next atomically
-            // Get the data and length (now safe to read since we successfully dequeued)
-            *data = first_node->data;
-            *length = first_node->length;
-            
-            // Update next_node->prev if it's not the tail
-            if (next_node != NULL && next_node != queue->tail) {
-                atomic_store_explicit(&next_node->prev, head, memory_order_release);
-            }
-            
-            atomic_fetch_sub_explicit(&queue->size, 1, memory_order_relaxed);
-            
-            // Increment dequeue counter - element has been successfully removed from the queue
-            atomic_fetch_add_explicit(&queue->dequeue_counter, 1, memory_order_relaxed);
-            
-            // Free the node structure (data is returned to caller, who is responsible for freeing it)
-            // Note: In a fully concurrent lock-free system, you'd use
-            // hazard pointers or epoch-based reclamation for safe memory reclamation
-            free(first_node);
-            return true;
-        }
-        
-        // CAS failed - another thread modified head->next, retry
-        // This is the key to lock-freedom: we retry instead of blocking
-        // Increment retry counter
-        atomic_fetch_add_explicit(&queue->dequeue_retries, 1, memory_order_relaxed);
-    }
-}
-
-// Check if queue is empty
-bool queue_is_empty(Queue* queue) {
-    if (queue == NULL) {
-        return true;
-    }
-    
-    size_t size = atomic_load_explicit(&queue->size, memory_order_acquire);
-    Node* first = atomic_load_explicit(&queue->head->next, memory_order_acquire);
-    return (size == 0) || (first == queue->tail);
-}
-
-// Get queue size
-size_t queue_size(Queue* queue) {
-    if (queue == NULL) {
-        return 0;
-    }
-    return atomic_load_explicit(&queue->size, memory_order_acquire);
-}
-
-// Print queue contents (for debugging)
-// If print_func is NULL, prints data address and length
-void queue_print(Queue* queue, void (*print_func)(const void* data, size_t length)) {
-    if (queue == NULL) {
-        printf("Queue is NULL\n");
-        return;
-    }
-    
-    printf("Queue (size: %zu): [", queue_size(queue));
-    
-    Node* current = atomic_load_explicit(&queue->head->next, memory_order_acquire);
-    bool first = true;
-    
-    while (current != NULL && current != queue->tail) {
-        if (!first) {
-            printf(", ");
-        }
-        
-        if (print_func != NULL) {
-            print_func(current->data, current->length);
-        } else {
-            // Default: print address and length
-            printf("(ptr: %p, len: %zu)", current->data, current->length);
-        }
-        
-        first = false;
-        current = atomic_load_explicit(&current->next, memory_order_acquire);
-    }
-    
-    printf("]\n");
-}
-
-// Print queue statistics (counters and size)
-void queue_print_stats(Queue* queue) {
-    if (queue == NULL) {
-        printf("Queue is NULL\n");
-        return;
-    }
-    
-    size_t size = atomic_load_explicit(&queue->size, memory_order_acquire);
-    unsigned int enqueue_count = atomic_load_explicit(&queue->enqueue_counter, memory_order_acquire);
-    unsigned int dequeue_count = atomic_load_explicit(&queue->dequeue_counter, memory_order_acquire);
-    unsigned int enqueue_retries = atomic_load_explicit(&queue->enqueue_retries, memory_order_acquire);
-    unsigned int dequeue_retries = atomic_load_explicit(&queue->dequeue_retries, memory_order_acquire);
-    
-    printf("Queue Statistics:\n");
-    printf("  Size: %zu\n", size);
-    printf("  Enqueue Counter: %u\n", enqueue_count);
-    printf("  Dequeue Counter: %u\n", dequeue_count);
-    printf("  Enqueue Retries: %u\n", enqueue_retries);
-    printf("  Dequeue Retries: %u\n", dequeue_retries);
-    printf("  Net Operations: %d\n", (int)(enqueue_count - dequeue_count));
-}
+#include "queue.h"
+#include "arena.h"
+#include "pool.h"
+#include "reclaim.h"
+#include "spill.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef QUEUE_NO_STATS
+#define QUEUE_STAT_ADD(queue, field, n) ((void)0)
+#else
+// Add n to a statistics counter in the calling thread's shard
+#define QUEUE_STAT_ADD(queue, field, n) \
+    atomic_fetch_add_explicit(&(queue)->stats[stat_shard()].field, (uint64_t)(n), memory_order_relaxed)
+
+static atomic_uint next_stat_shard = 0;
+static _Thread_local unsigned int local_stat_shard = QUEUE_STAT_SHARDS;
+
+// Shard used by the calling thread (assigned round-robin on first use)
+static inline unsigned int stat_shard(void) {
+    unsigned int shard = local_stat_shard;
+    if (shard == QUEUE_STAT_SHARDS) {
+        shard = atomic_fetch_add_explicit(&next_stat_shard, 1, memory_order_relaxed) % QUEUE_STAT_SHARDS;
+        local_stat_shard = shard;
+    }
+    return shard;
+}
+#endif
+
+#ifdef QUEUE_TRACE
+// CAS retries of the operation the calling thread is in the middle of
+static _Thread_local uint32_t trace_retries = 0;
+
+// Count a failed CAS attempt and charge it to the current operation
+#define QUEUE_STAT_RETRY(queue, field) (QUEUE_STAT_ADD(queue, field, 1), trace_retries++)
+
+// End the calling thread's operation: add its retry count to histogram field
+#define QUEUE_TRACE_OP_END(queue, field) \
+    (atomic_fetch_add_explicit(&(queue)->stats[stat_shard()].field[trace_bucket(trace_retries)], 1, \
+                               memory_order_relaxed), \
+     trace_retries = 0)
+#else
+// Count a failed CAS attempt
+#define QUEUE_STAT_RETRY(queue, field) QUEUE_STAT_ADD(queue, field, 1)
+#define QUEUE_TRACE_OP_END(queue, field) ((void)0)
+#endif
+
+// Set a node's NODE_* flags, keeping the pool bits
+static inline void node_set_flags(Node* node, uint32_t flags) {
+    node->flags = (node->flags & NODE_POOL_MASK) | flags;
+}
+
+// Advance a producer or consumer ticket by n
+// Tickets are written only by their own side, so counting an element never
+// touches a line the other side is using
+static inline void ticket_add(atomic_size_t* ticket, size_t n) {
+    atomic_fetch_add_explicit(ticket, n, memory_order_release);
+}
+
+// Advance a ticket that only one thread writes (no read-modify-write needed)
+static inline void ticket_add_single(atomic_size_t* ticket, size_t n) {
+    atomic_store_explicit(ticket, atomic_load_explicit(ticket, memory_order_relaxed) + n, memory_order_release);
+}
+
+// Set a node's back-link (compiled out with QUEUE_SINGLY_LINKED)
+static inline void node_set_prev(Node* node, Node* prev) {
+#ifndef QUEUE_SINGLY_LINKED
+    atomic_store_explicit(&node->prev, prev, memory_order_relaxed);
+#else
+    (void)node;
+    (void)prev;
+#endif
+}
+
+// Stamp a node with its enqueue time (compiled out without QUEUE_TRACE)
+static inline void node_trace_stamp(Node* node) {
+#ifdef QUEUE_TRACE
+    node->enqueue_ticks = trace_ticks();
+#else
+    (void)node;
+#endif
+}
+
+// Record how long a dequeued node spent in the queue (compiled out without QUEUE_TRACE)
+static inline void node_trace_dequeued(Queue* queue, const Node* node) {
+#ifdef QUEUE_TRACE
+    uint64_t ticks = trace_ticks() - node->enqueue_ticks;
+    atomic_fetch_add_explicit(&queue->stats[stat_shard()].residency[trace_bucket(ticks)], 1, memory_order_relaxed);
+    QUEUE_TRACE_PROBE(dequeue, queue, node->length, ticks);
+#else
+    (void)queue;
+    (void)node;
+#endif
+}
+
+// Allocate and initialize a new node from the queue's pool
+static Node* node_create(Queue* queue, const void* data, size_t length) {
+    if (length > UINT32_MAX) {
+        return NULL;  // Lengths are stored in 32 bits
+    }
+    
+    Node* node = node_pool_alloc_on(queue->numa_node);
+    if (node == NULL) {
+        return NULL;
+    }
+    
+    // Small payloads are copied into the node itself; larger ones get their own buffer
+    if (data != NULL && length > 0) {
+        if (length <= QUEUE_INLINE_MAX) {
+            memcpy(node->payload.bytes, data, length);
+            node_set_flags(node, NODE_INLINE);
+        } else {
+            node->payload.data = (queue->arena != NULL) ? arena_alloc(queue->arena, length) : malloc(length);
+            if (node->payload.data == NULL) {
+                node_pool_free(node);
+                return NULL;
+            }
+            memcpy(node->payload.data, data, length);
+            node_set_flags(node, (queue->arena != NULL) ? NODE_ARENA : 0);
+        }
+        node->length = (uint32_t)length;
+    } else {
+        node->payload.data = NULL;
+        node->length = 0;
+        node_set_flags(node, 0);
+    }
+    
+    // Initialize prev and next with NULL pointer
+    // (stores rather than atomic_init: a recycled node may still be read by a stale pool pop)
+    node_set_prev(node, NULL);
+    atomic_store_explicit(&node->next, (Node*)NULL, memory_order_relaxed);
+    node_trace_stamp(node);
+    return node;
+}
+
+// Payload storage that stays with the queue: handoff dequeues copy it out
+#define NODE_COPY_OUT (NODE_INLINE | NODE_ARENA)
+
+// Address of a node's payload bytes
+static inline const void* node_payload(const Node* node) {
+    return (node->flags & NODE_INLINE) ? (const void*)node->payload.bytes : node->payload.data;
+}
+
+// Heap payloads (copies and owned buffers) leave the queue with whoever
+// claims their node, and may be freed right away. A thread that reads one in
+// place without claiming it (a dequeue_if predicate, queue_peek) first pins
+// it: it announces itself in inspectors and then checks that slot still
+// holds expected, i.e. that nobody has claimed the node yet. A consumer that
+// claims a node with a heap payload waits in payload_settle until no reader
+// is announced. Both sides use seq_cst, so either the reader sees the claim
+// and backs off, or the claimer sees the reader and waits for it.
+static inline bool node_payload_heap(const Node* node) {
+    return !(node->flags & NODE_COPY_OUT);
+}
+
+// Pin a heap payload for reading in place; false if its node was claimed
+static bool payload_pin(Queue* queue, _Atomic(Node*)* slot, Node* expected) {
+    atomic_fetch_add_explicit(&queue->inspectors, 1, memory_order_seq_cst);
+    if (atomic_load_explicit(slot, memory_order_seq_cst) == expected) {
+        return true;
+    }
+    atomic_fetch_sub_explicit(&queue->inspectors, 1, memory_order_release);
+    return false;
+}
+
+static inline void payload_unpin(Queue* queue) {
+    atomic_fetch_sub_explicit(&queue->inspectors, 1, memory_order_release);
+}
+
+// Wait until no reader can still be looking at the heap payload of a node
+// this thread has claimed (called after the claim, before the handoff)
+static inline void payload_settle(Queue* queue) {
+    while (atomic_load_explicit(&queue->inspectors, memory_order_seq_cst) != 0) {
+        backoff_cpu_relax();
+    }
+}
+
+// Allocate a node that takes over an existing buffer without copying it
+static Node* node_create_owned(Queue* queue, void* data, size_t length) {
+    if (length > UINT32_MAX) {
+        return NULL;  // Lengths are stored in 32 bits
+    }
+    
+    Node* node = node_pool_alloc_on(queue->numa_node);
+    if (node == NULL) {
+        return NULL;
+    }
+    
+    node->payload.data = data;
+    node->length = (uint32_t)length;
+    node_set_flags(node, NODE_OWNED);
+    node_set_prev(node, NULL);
+    atomic_store_explicit(&node->next, (Node*)NULL, memory_order_relaxed);
+    node_trace_stamp(node);
+    return node;
+}
+
+// Release a heap payload the queue still owns
+// Owned buffers go to the queue's destructor if one is registered, otherwise
+// they are assumed to come from malloc like the queue's own copies. Arena
+// payloads are only released with the whole arena.
+static void payload_release(Queue* queue, Node* node) {
+    if (node->flags & NODE_ARENA) {
+        return;
+    }
+    if ((node->flags & NODE_OWNED) && queue->destructor != NULL) {
+        queue->destructor(node->payload.data, node->length);
+    } else if (node->payload.data != NULL) {
+        free(node->payload.data);
+    }
+}
+
+// Free node and its data
+static void node_destroy(Queue* queue, Node* node) {
+    if (node != NULL) {
+        if (!(node->flags & NODE_INLINE)) {
+            payload_release(queue, node);
+        }
+        node_pool_free(node);
+    }
+}
+
+// Reclamation callback for dequeued dummy nodes (their data now belongs to the caller)
+static void node_reclaim(void* ptr) {
+    node_pool_free((Node*)ptr);
+}
+
+// Segment of a QUEUE_MODE_SEGMENT queue (FAAArrayQueue-style)
+// Producers claim cells with a fetch-and-add on enqueue_index and publish a
+// node with one CAS on the cell; consumers claim cells with a fetch-and-add
+// on dequeue_index and take the node with an exchange. A consumer that gets
+// to a cell before its producer poisons it (SEGMENT_TAKEN), and the producer
+// claims another cell. Full segments are chained; the oldest one is retired
+// through reclaim_retire once every cell has been claimed.
+typedef struct QueueSegment {
+    int numa_node;  // NUMA node the segment is placed on (-1: unbound)
+    _Alignas(QUEUE_CACHELINE) atomic_size_t dequeue_index;  // Next cell to claim (consumers)
+    _Alignas(QUEUE_CACHELINE) atomic_size_t enqueue_index;  // Next cell to claim (producers)
+    _Alignas(QUEUE_CACHELINE) _Atomic(struct QueueSegment*) next;  // Newer segment
+    _Atomic(Node*) cells[QUEUE_SEGMENT_SIZE];
+} QueueSegment;
+
+// Cell state after a consumer has claimed it
+#define SEGMENT_TAKEN ((Node*)(uintptr_t)1)
+
+// Allocate an empty segment on the queue's NUMA node, optionally holding first in cell 0
+static QueueSegment* segment_create(const Queue* queue, Node* first) {
+    QueueSegment* segment = (queue->numa_node < 0)
+        ? (QueueSegment*)queue_mem_alloc_aligned(_Alignof(QueueSegment), sizeof(QueueSegment))
+        : (QueueSegment*)queue_mem_alloc_on_node(sizeof(QueueSegment), queue->numa_node);
+    if (segment == NULL) {
+        return NULL;
+    }
+    segment->numa_node = queue->numa_node;
+    atomic_init(&segment->dequeue_index, 0);
+    atomic_init(&segment->enqueue_index, first != NULL ? 1 : 0);
+    atomic_init(&segment->next, (QueueSegment*)NULL);
+    for (size_t i = 0; i < QUEUE_SEGMENT_SIZE; i++) {
+        atomic_init(&segment->cells[i], (Node*)NULL);
+    }
+    if (first != NULL) {
+        atomic_init(&segment->cells[0], first);
+    }
+    return segment;
+}
+
+// Free a segment
+static void segment_free(QueueSegment* segment) {
+    if (segment->numa_node < 0) {
+        queue_mem_free_aligned(segment);
+    } else {
+        queue_mem_free_on_node(segment, sizeof(QueueSegment));
+    }
+}
+
+// Reclamation callback for segments every cell of which has been claimed
+static void segment_reclaim(void* ptr) {
+    segment_free((QueueSegment*)ptr);
+}
+
+// Overflow tier of a queue (see queue_set_spill)
+// While SPILL_ACTIVE is set in state, enqueues append to the log instead of
+// linking, so nothing enqueued later can overtake an element already spilled.
+// The rest of state counts the appends started: an appender registers with a
+// CAS that only succeeds while the tier is active (or switches it on), and
+// ticks finished when done. The refilling consumer switches the tier off with
+// a CAS on a state whose appends have all finished and been drained; a new
+// registration changes the count, so the CAS fails rather than strand it.
+typedef struct QueueSpill {
+    SpillLog* log;
+    size_t high_water;     // Spill once this many elements are in memory
+    size_t low_water;      // Refill once no more than this many are
+    _Alignas(QUEUE_CACHELINE) atomic_uint_fast64_t state;  // (appends started << 1) | SPILL_ACTIVE
+    atomic_uint_fast64_t finished;  // Appends completed
+    _Alignas(QUEUE_CACHELINE) atomic_flag draining;  // Held by the consumer refilling the list
+} QueueSpill;
+
+#define SPILL_ACTIVE 1u
+
+// Spill record payload for an owned buffer: the buffer stays where it is
+typedef struct SpilledOwned {
+    void* data;
+    uint64_t length;
+} SpilledOwned;
+
+// Free a queue structure
+static void queue_free(Queue* queue) {
+    if (queue->numa_node < 0) {
+        queue_mem_free_aligned(queue);
+    } else {
+        queue_mem_free_on_node(queue, sizeof(Queue));
+    }
+}
+
+// Initialize an empty queue with a dummy node
+Queue* queue_init(void) {
+    return queue_init_mode(QUEUE_MODE_MPMC);
+}
+
+// Initialize an empty queue specialised for the given producer/consumer cardinality
+Queue* queue_init_mode(QueueMode mode) {
+    return queue_init_numa(mode, -1);
+}
+
+// Initialize an empty queue whose structure, nodes and segments are placed on
+// NUMA node numa_node (-1: wherever the allocator puts them)
+// Bind a queue to the node its consumers run on: producers on other nodes
+// then only pay for the handoff writes, and consumers read local memory
+Queue* queue_init_numa(QueueMode mode, int numa_node) {
+    if (mode != QUEUE_MODE_MPMC && mode != QUEUE_MODE_MPSC && mode != QUEUE_MODE_SPSC &&
+        mode != QUEUE_MODE_SEGMENT && mode != QUEUE_MODE_PRIORITY) {
+        return NULL;
+    }
+    if (numa_node < -1 || numa_node >= QUEUE_NUMA_MAX_NODES) {
+        return NULL;
+    }
+    
+    Queue* queue = (numa_node < 0)
+        ? (Queue*)queue_mem_alloc_aligned(_Alignof(Queue), sizeof(Queue))
+        : (Queue*)queue_mem_alloc_on_node(sizeof(Queue), numa_node);
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->numa_node = numa_node;
+    
+    // Create the dummy node (no data); head and tail both start on it
+    // (segment queues keep it too, so head and tail are never NULL)
+    Node* dummy = node_create(queue, NULL, 0);
+    if (dummy == NULL) {
+        queue_free(queue);
+        return NULL;
+    }
+    
+    QueueSegment* segment = NULL;
+    if (mode == QUEUE_MODE_SEGMENT) {
+        segment = segment_create(queue, NULL);
+        if (segment == NULL) {
+            node_pool_free(dummy);
+            queue_free(queue);
+            return NULL;
+        }
+    }
+    
+    atomic_init(&queue->head, dummy);
+    atomic_init(&queue->tail, dummy);
+    atomic_init(&queue->head_segment, segment);
+    atomic_init(&queue->tail_segment, segment);
+    atomic_init(&queue->enqueue_ticket, 0);
+    atomic_init(&queue->dequeue_ticket, 0);
+    atomic_init(&queue->inspectors, 0);
+    atomic_init(&queue->level_mask, 0u);
+    atomic_init(&queue->closed, (unsigned int)QUEUE_OPEN);
+#ifndef QUEUE_NO_STATS
+    for (size_t i = 0; i < QUEUE_STAT_SHARDS; i++) {
+        atomic_init(&queue->stats[i].enqueued, 0);
+        atomic_init(&queue->stats[i].dequeued, 0);
+        atomic_init(&queue->stats[i].enqueue_retries, 0);
+        atomic_init(&queue->stats[i].dequeue_retries, 0);
+#ifdef QUEUE_TRACE
+        for (size_t b = 0; b < QUEUE_TRACE_BUCKETS; b++) {
+            atomic_init(&queue->stats[i].residency[b], 0);
+            atomic_init(&queue->stats[i].enqueue_retry_ops[b], 0);
+            atomic_init(&queue->stats[i].dequeue_retry_ops[b], 0);
+        }
+#endif
+    }
+#endif
+#ifdef QUEUE_TRACE
+    queue->trace_origin_ticks = trace_ticks();
+    queue->trace_origin_ns = eventcount_now_ns();
+#endif
+    queue->destructor = NULL;
+    queue->spill = NULL;
+    queue->arena = NULL;
+    queue->mode = mode;
+    queue->backoff = backoff_config_default(BACKOFF_NONE);
+    eventcount_init(&queue->not_empty);
+    
+    // Priority queues keep their elements in one ordinary MPMC queue per level
+    for (size_t i = 0; i < QUEUE_PRIORITY_LEVELS; i++) {
+        queue->levels[i] = NULL;
+    }
+    if (mode == QUEUE_MODE_PRIORITY) {
+        for (size_t i = 0; i < QUEUE_PRIORITY_LEVELS; i++) {
+            queue->levels[i] = queue_init_numa(QUEUE_MODE_MPMC, numa_node);
+            if (queue->levels[i] == NULL) {
+                queue_destroy(queue);
+                return NULL;
+            }
+        }
+    }
+    
+    return queue;
+}
+
+// Initialize an empty queue and preallocate nodes for capacity elements
+// The nodes go to the shared node pool, so the first burst never hits malloc
+Queue* queue_init_with_pool(size_t capacity) {
+    if (!node_pool_reserve(capacity)) {
+        return NULL;
+    }
+    return queue_init();
+}
+
+// Release an element still in the spill log at destroy
+// Copied payloads live in the mapping; owned buffers go to the destructor
+static void spill_release(uint32_t flags, const void* data, size_t length, void* ctx) {
+    (void)length;
+    if (flags & NODE_OWNED) {
+        Queue* queue = (Queue*)ctx;
+        const SpilledOwned* owned = (const SpilledOwned*)data;
+        if (queue->destructor != NULL) {
+            queue->destructor(owned->data, (size_t)owned->length);
+        } else {
+            free(owned->data);
+        }
+    }
+}
+
+// Close the queue: every later enqueue fails, while the elements already in
+// it can still be dequeued. Once they are all gone, queue_dequeue_wait returns
+// QUEUE_WAIT_CLOSED, and consumers parked in it are woken to see that.
+// Returns after any enqueue that raced with the close has landed or failed,
+// so nothing arrives after it returns. Returns false if already closed.
+bool queue_close(Queue* queue) {
+    if (queue == NULL) {
+        return false;
+    }
+    unsigned int expected = QUEUE_OPEN;
+    if (!atomic_compare_exchange_strong_explicit(&queue->closed, &expected, QUEUE_CLOSING,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed)) {
+        return false;
+    }
+    
+    // Enqueues run in critical sections and check the state inside them:
+    // once those active now have ended, every enqueue that missed the close
+    // has finished linking
+    reclaim_synchronize();
+    atomic_store_explicit(&queue->closed, QUEUE_CLOSED, memory_order_release);
+    eventcount_notify(&queue->not_empty, true);
+    return true;
+}
+
+// Check if the queue has been closed (queue_close has started)
+bool queue_is_closed(Queue* queue) {
+    return queue != NULL && atomic_load_explicit(&queue->closed, memory_order_acquire) != QUEUE_OPEN;
+}
+
+// True once the queue is closed and holds no more elements
+// Consumers still finishing a dequeue may keep the tickets apart briefly
+static inline bool queue_drained(Queue* queue) {
+    return atomic_load_explicit(&queue->closed, memory_order_acquire) == QUEUE_CLOSED && queue_is_empty(queue);
+}
+
+// Destroy queue and free all memory
+// Must not be called while other threads are still using the queue (close it
+// and let the consumers see QUEUE_WAIT_CLOSED first)
+void queue_destroy(Queue* queue) {
+    if (queue == NULL) {
+        return;
+    }
+    
+    // The dummy's data was already handed out by dequeue; every later node
+    // still owns its data
+    Node* dummy = atomic_load_explicit(&queue->head, memory_order_acquire);
+    Node* current = atomic_load_explicit(&dummy->next, memory_order_acquire);
+    node_pool_free(dummy);
+    
+    while (current != NULL) {
+        Node* next = atomic_load_explicit(&current->next, memory_order_acquire);
+        node_destroy(queue, current);
+        current = next;
+    }
+    
+    // Segment queues: every cell still holding a node owns its element
+    QueueSegment* segment = atomic_load_explicit(&queue->head_segment, memory_order_acquire);
+    while (segment != NULL) {
+        QueueSegment* next = atomic_load_explicit(&segment->next, memory_order_acquire);
+        for (size_t i = 0; i < QUEUE_SEGMENT_SIZE; i++) {
+            Node* node = atomic_load_explicit(&segment->cells[i], memory_order_acquire);
+            if (node != NULL && node != SEGMENT_TAKEN) {
+                node_destroy(queue, node);
+            }
+        }
+        segment_free(segment);
+        segment = next;
+    }
+    
+    for (size_t i = 0; i < QUEUE_PRIORITY_LEVELS; i++) {
+        queue_destroy(queue->levels[i]);
+    }
+    
+    if (queue->spill != NULL) {
+        spill_close(queue->spill->log, spill_release, queue);
+        queue_mem_free_aligned(queue->spill);
+    }
+    arena_destroy(queue->arena);  // After the nodes: they may point into it
+    
+    eventcount_destroy(&queue->not_empty);
+    queue_free(queue);
+}
+
+// Back off after a failed CAS inside a critical section
+// The critical section is left while waiting, so a thread that spins or
+// yields does not hold back reclamation for everyone else
+static inline void contention_wait(Backoff* backoff) {
+    if (backoff_enabled(backoff)) {
+        reclaim_exit();
+        backoff_wait(backoff);
+        reclaim_enter();
+    }
+}
+
+// MPMC: link a prepared chain of count nodes at the tail (lock-free with retry)
+// The chain is spliced with the same single CAS as one node
+static void mpmc_enqueue(Queue* queue, Node* first, Node* last, size_t count) {
+    Backoff backoff;
+    backoff_init(&backoff, &queue->backoff);
+    
+    // The tail node must not be reclaimed while we dereference it
+    reclaim_enter();
+    
+    // Lock-free insertion with retry loop
+    while (true) {
+        Node* tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        Node* next = atomic_load_explicit(&tail->next, memory_order_acquire);
+        
+        if (next != NULL) {
+            // Tail is lagging behind another enqueue: help swing it forward and retry
+            atomic_compare_exchange_strong_explicit(&queue->tail, &tail, next,
+                                                    memory_order_release,
+                                                    memory_order_relaxed);
+            QUEUE_STAT_RETRY(queue, enqueue_retries);
+            continue;
+        }
+        
+        // Back-link to the current last node (local write, published by the CAS below)
+        node_set_prev(first, tail);
+        
+        // Atomically link the chain after the last node; the release ordering
+        // makes the nodes' data visible to whichever threads dequeue them
+        Node* expected_next = NULL;
+        if (atomic_compare_exchange_strong_explicit(&tail->next, &expected_next,
+                                                    first,
+                                                    memory_order_release,
+                                                    memory_order_acquire)) {
+            // Linked: swing tail to the chain's end (failure means another thread
+            // already helped; helpers then walk the rest of the chain one node at a time)
+            atomic_compare_exchange_strong_explicit(&queue->tail, &tail, last,
+                                                    memory_order_release,
+                                                    memory_order_relaxed);
+            reclaim_exit();
+            backoff_done(&backoff);
+            
+            ticket_add(&queue->enqueue_ticket, count);
+            
+            // Increment enqueue counter - elements have been successfully added to the queue
+            QUEUE_STAT_ADD(queue, enqueued, count);
+            return;
+        }
+        
+        // CAS failed - another thread appended first, retry
+        // This is the key to lock-freedom: we retry instead of blocking
+        // Increment retry counter
+        QUEUE_STAT_RETRY(queue, enqueue_retries);
+        contention_wait(&backoff);
+    }
+}
+
+// MPSC: swap the tail with an exchange, then link the previous tail to us
+// No CAS loop: every producer succeeds on its first attempt. Until the link
+// store lands the consumer sees the list end at the previous node.
+static void mpsc_enqueue(Queue* queue, Node* first, Node* last, size_t count) {
+    Node* prev = atomic_exchange_explicit(&queue->tail, last, memory_order_acq_rel);
+    node_set_prev(first, prev);
+    atomic_store_explicit(&prev->next, first, memory_order_release);
+    
+    ticket_add(&queue->enqueue_ticket, count);
+    QUEUE_STAT_ADD(queue, enqueued, count);
+}
+
+// SPSC: the producer owns the tail, so appending is two plain stores (wait-free)
+// The consumer never recycles the last node, so the tail stays valid
+static void spsc_enqueue(Queue* queue, Node* first, Node* last, size_t count) {
+    Node* tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    node_set_prev(first, tail);
+    atomic_store_explicit(&tail->next, first, memory_order_release);
+    atomic_store_explicit(&queue->tail, last, memory_order_relaxed);
+    
+    ticket_add_single(&queue->enqueue_ticket, count);
+    QUEUE_STAT_ADD(queue, enqueued, count);
+}
+
+// SEGMENT: claim a cell with fetch-and-add and publish node there
+// Returns false only if a new segment was needed and could not be allocated
+static bool segment_enqueue_node(Queue* queue, Node* node) {
+    reclaim_enter();
+    while (true) {
+        QueueSegment* segment = atomic_load_explicit(&queue->tail_segment, memory_order_acquire);
+        size_t index = atomic_fetch_add_explicit(&segment->enqueue_index, 1, memory_order_relaxed);
+        
+        if (index >= QUEUE_SEGMENT_SIZE) {
+            // Segment is full: append a new one that already holds our node
+            if (segment != atomic_load_explicit(&queue->tail_segment, memory_order_acquire)) {
+                continue;
+            }
+            QueueSegment* next = atomic_load_explicit(&segment->next, memory_order_acquire);
+            if (next == NULL) {
+                QueueSegment* fresh = segment_create(queue, node);
+                if (fresh == NULL) {
+                    reclaim_exit();
+                    return false;
+                }
+                QueueSegment* expected = NULL;
+                if (atomic_compare_exchange_strong_explicit(&segment->next, &expected, fresh,
+                                                            memory_order_release,
+                                                            memory_order_acquire)) {
+                    atomic_compare_exchange_strong_explicit(&queue->tail_segment, &segment, fresh,
+                                                            memory_order_release,
+                                                            memory_order_relaxed);
+                    reclaim_exit();
+                    return true;
+                }
+                segment_free(fresh);  // Never published
+                next = expected;
+            }
+            // Help the tail forward to the segment another producer appended
+            atomic_compare_exchange_strong_explicit(&queue->tail_segment, &segment, next,
+                                                    memory_order_release,
+                                                    memory_order_relaxed);
+            QUEUE_STAT_RETRY(queue, enqueue_retries);
+            continue;
+        }
+        
+        // Publish the node; failure means a consumer poisoned the cell first
+        Node* expected = NULL;
+        if (atomic_compare_exchange_strong_explicit(&segment->cells[index], &expected, node,
+                                                    memory_order_release,
+                                                    memory_order_relaxed)) {
+            reclaim_exit();
+            return true;
+        }
+        QUEUE_STAT_RETRY(queue, enqueue_retries);
+    }
+}
+
+// SEGMENT: enqueue a chain of count nodes one cell at a time
+// The nodes stay in order, but elements of concurrent producers may land in
+// between them. Returns the number enqueued (less than count only if a new
+// segment could not be allocated; the rest of the chain is left untouched).
+static size_t segment_enqueue(Queue* queue, Node* first, size_t count) {
+    Node* node = first;
+    size_t enqueued = 0;
+    while (enqueued < count) {
+        Node* next = atomic_load_explicit(&node->next, memory_order_relaxed);
+        if (!segment_enqueue_node(queue, node)) {
+            break;
+        }
+        enqueued++;
+        node = next;
+    }
+    
+    ticket_add(&queue->enqueue_ticket, enqueued);
+    QUEUE_STAT_ADD(queue, enqueued, enqueued);
+    return enqueued;
+}
+
+// PRIORITY: link a prepared chain at the tail of one level and mark it non-empty
+// The fence pairs with the one in priority_clear: either we see the level's
+// bit cleared and set it again, or the clearing consumer sees our element
+static void priority_enqueue(Queue* queue, Node* first, Node* last, size_t count, unsigned int priority) {
+    mpmc_enqueue(queue->levels[priority], first, last, count);
+    
+    unsigned int bit = 1u << priority;
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!(atomic_load_explicit(&queue->level_mask, memory_order_relaxed) & bit)) {
+        atomic_fetch_or_explicit(&queue->level_mask, bit, memory_order_seq_cst);
+    }
+}
+
+// Number of elements in memory, from the producer and consumer tickets
+static size_t list_size(Queue* queue) {
+    if (queue->mode == QUEUE_MODE_PRIORITY) {
+        size_t size = 0;
+        for (size_t i = 0; i < QUEUE_PRIORITY_LEVELS; i++) {
+            size += list_size(queue->levels[i]);
+        }
+        return size;
+    }
+    // Read the consumer ticket first, so the producer ticket can only have
+    // grown since; it still lags for elements dequeued before their producer
+    // counted them, hence the clamp
+    size_t dequeued = atomic_load_explicit(&queue->dequeue_ticket, memory_order_acquire);
+    size_t enqueued = atomic_load_explicit(&queue->enqueue_ticket, memory_order_acquire);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+// Link a prepared chain of count nodes at the tail using the queue's mode
+// Returns the number of nodes linked (always count except in SEGMENT mode
+// when out of memory; the unlinked rest of the chain stays with the caller)
+static size_t list_link(Queue* queue, Node* first, Node* last, size_t count) {
+    size_t enqueued = count;
+    switch (queue->mode) {
+        case QUEUE_MODE_SPSC:
+            spsc_enqueue(queue, first, last, count);
+            break;
+        case QUEUE_MODE_MPSC:
+            mpsc_enqueue(queue, first, last, count);
+            break;
+        case QUEUE_MODE_SEGMENT:
+            enqueued = segment_enqueue(queue, first, count);
+            break;
+        case QUEUE_MODE_PRIORITY:
+            priority_enqueue(queue, first, last, count, QUEUE_PRIORITY_LOWEST);
+            break;
+        default:
+            mpmc_enqueue(queue, first, last, count);
+            break;
+    }
+    return enqueued;
+}
+
+// Bytes a node's element takes in the spill log
+static inline size_t spilled_length(const Node* node) {
+    return (node->flags & NODE_OWNED) ? sizeof(SpilledOwned) : node->length;
+}
+
+// Append a prepared chain to the spill log if the tier is active, or switch
+// it on if the list has reached the high-water mark
+// Returns false if the chain should be linked instead. Otherwise *enqueued is
+// the number of nodes taken, which are gone. Records are reserved a segment's
+// worth at a time, so a chain that fits in a segment stays one contiguous run
+// and a longer one is split. If a segment file cannot be created, the rest of
+// the chain is linked in memory rather than dropped (it may then overtake
+// elements still in the log); *enqueued only falls short of count, with the
+// rest left with the caller, when that link fails too (see list_link).
+static bool spill_enqueue(Queue* queue, Node* first, Node* last, size_t count, size_t* enqueued) {
+    QueueSpill* spill = queue->spill;
+    uint_fast64_t state = atomic_load_explicit(&spill->state, memory_order_acquire);
+    while (true) {
+        uint_fast64_t desired;
+        if (state & SPILL_ACTIVE) {
+            desired = state + 2;
+        } else if (list_size(queue) >= spill->high_water) {
+            desired = (state | SPILL_ACTIVE) + 2;
+        } else {
+            return false;
+        }
+        if (atomic_compare_exchange_weak_explicit(&spill->state, &state, desired,
+                                                  memory_order_acq_rel,
+                                                  memory_order_acquire)) {
+            break;
+        }
+    }
+    
+    size_t segment_bytes = spill->log->segment_bytes;
+    size_t spilled = 0;
+    Node* node = first;
+    while (spilled < count) {
+        // Take records while they fit in one segment (a record larger than a
+        // segment goes alone and gets a segment of its own)
+        size_t bytes = 0;
+        size_t run = 0;
+        Node* scan = node;
+        while (spilled + run < count) {
+            size_t record = spill_record_size(spilled_length(scan));
+            if (run > 0 && bytes + record > segment_bytes) {
+                break;
+            }
+            bytes += record;
+            run++;
+            scan = atomic_load_explicit(&scan->next, memory_order_relaxed);
+        }
+        
+        SpillReservation reservation;
+        if (!spill_reserve(spill->log, bytes, &reservation)) {
+            break;
+        }
+        for (size_t i = 0; i < run; i++) {
+            Node* next = atomic_load_explicit(&node->next, memory_order_relaxed);
+            if (node->flags & NODE_OWNED) {
+                SpilledOwned owned = { node->payload.data, node->length };
+                spill_write(&reservation, NODE_OWNED, &owned, sizeof(owned));
+                node_pool_free(node);
+            } else {
+                spill_write(&reservation, 0, node_payload(node), node->length);
+                node_destroy(queue, node);
+            }
+            node = next;
+        }
+        spill_finish(spill->log, &reservation);
+        spilled += run;
+    }
+    atomic_fetch_add_explicit(&spill->finished, 1, memory_order_release);
+    
+    *enqueued = spilled;
+    if (spilled < count) {
+        *enqueued += list_link(queue, node, last, count - spilled);
+    }
+    return true;
+}
+
+// Start an enqueue: enter the critical section queue_close waits out, then
+// check the queue is still open (false: closed, and the section was left)
+// The fence in reclaim_enter pairs with the grace period in queue_close:
+// either this load sees the queue closing, or the close waits for us
+static inline bool enqueue_begin(Queue* queue) {
+    reclaim_enter();
+    if (atomic_load_explicit(&queue->closed, memory_order_relaxed) != QUEUE_OPEN) {
+        reclaim_exit();
+        return false;
+    }
+    return true;
+}
+
+// Enqueue a prepared chain of count nodes: spill it or link it
+// Returns the number of nodes enqueued, as list_link (0 if the queue is closed)
+static inline size_t list_enqueue(Queue* queue, Node* first, Node* last, size_t count) {
+    if (!enqueue_begin(queue)) {
+        return 0;
+    }
+    size_t enqueued;
+    if (queue->spill == NULL || !spill_enqueue(queue, first, last, count, &enqueued)) {
+        enqueued = list_link(queue, first, last, count);
+    }
+    reclaim_exit();
+    
+    // Wake a parked consumer (one fence and one load when nobody sleeps)
+    if (enqueued > 0) {
+        eventcount_notify(&queue->not_empty, enqueued > 1);
+    }
+    QUEUE_TRACE_PROBE(enqueue, queue, enqueued, trace_retries);
+    QUEUE_TRACE_OP_END(queue, enqueue_retry_ops);
+    return enqueued;
+}
+
+// Enqueue a copy of an element at the tail
+bool queue_enqueue(Queue* queue, const void* data, size_t length) {
+    if (queue == NULL) {
+        return false;
+    }
+    
+    if (data == NULL && length > 0) {
+        return false;  // Invalid: data is NULL but length > 0
+    }
+    
+    Node* new_node = node_create(queue, data, length);
+    if (new_node == NULL) {
+        return false;
+    }
+    
+    if (list_enqueue(queue, new_node, new_node, 1) == 0) {
+        node_destroy(queue, new_node);
+        return false;
+    }
+    return true;
+}
+
+// Enqueue a copy of an element at the tail of priority level priority
+// (0 is the most urgent). Queues in other modes ignore the level.
+bool queue_enqueue_priority(Queue* queue, const void* data, size_t length, unsigned int priority) {
+    if (queue == NULL || priority >= QUEUE_PRIORITY_LEVELS) {
+        return false;
+    }
+    if (queue->mode != QUEUE_MODE_PRIORITY || priority == QUEUE_PRIORITY_LOWEST) {
+        return queue_enqueue(queue, data, length);
+    }
+    
+    if (data == NULL && length > 0) {
+        return false;  // Invalid: data is NULL but length > 0
+    }
+    
+    Node* new_node = node_create(queue, data, length);
+    if (new_node == NULL) {
+        return false;
+    }
+    
+    if (!enqueue_begin(queue)) {
+        node_destroy(queue, new_node);
+        return false;
+    }
+    priority_enqueue(queue, new_node, new_node, 1, priority);
+    reclaim_exit();
+    eventcount_notify(&queue->not_empty, false);
+    QUEUE_TRACE_PROBE(enqueue, queue, 1, trace_retries);
+    QUEUE_TRACE_OP_END(queue, enqueue_retry_ops);
+    return true;
+}
+
+// Enqueue an element at the tail, taking ownership of data without copying it
+// The buffer is handed to whoever dequeues it; if it is still queued when the
+// queue is destroyed it is released with the queue's destructor (or free())
+bool queue_enqueue_owned(Queue* queue, void* data, size_t length) {
+    if (queue == NULL) {
+        return false;
+    }
+    
+    if (data == NULL && length > 0) {
+        return false;  // Invalid: data is NULL but length > 0
+    }
+    
+    Node* new_node = node_create_owned(queue, data, length);
+    if (new_node == NULL) {
+        return false;
+    }
+    
+    if (list_enqueue(queue, new_node, new_node, 1) == 0) {
+        node_pool_free(new_node);  // The caller keeps the buffer
+        return false;
+    }
+    return true;
+}
+
+// Enqueue copies of n elements as one contiguous run
+// The chain is built privately and spliced in with a single link, so the
+// elements appear atomically and in order. Either all n are enqueued or none.
+// SEGMENT queues enqueue the elements one cell at a time: they stay in order
+// but may interleave with other producers, and if a new segment cannot be
+// allocated a prefix of the batch stays enqueued (false is still returned).
+bool queue_enqueue_batch(Queue* queue, const void** items, const size_t* lengths, size_t n) {
+    if (queue == NULL || (n > 0 && (items == NULL || lengths == NULL))) {
+        return false;
+    }
+    if (n == 0) {
+        return true;
+    }
+    
+    Node* first = NULL;
+    Node* last = NULL;
+    for (size_t i = 0; i < n; i++) {
+        Node* node = (items[i] != NULL || lengths[i] == 0) ? node_create(queue, items[i], lengths[i]) : NULL;
+        if (node == NULL) {
+            // Invalid element or out of memory: undo the partial chain
+            while (first != NULL) {
+                Node* next = atomic_load_explicit(&first->next, memory_order_relaxed);
+                node_destroy(queue, first);
+                first = next;
+            }
+            return false;
+        }
+        
+        if (last == NULL) {
+            first = node;
+        } else {
+            node_set_prev(node, last);
+            atomic_store_explicit(&last->next, node, memory_order_relaxed);
+        }
+        last = node;
+    }
+    
+    size_t enqueued = list_enqueue(queue, first, last, n);
+    if (enqueued < n) {
+        // Closed, or SEGMENT mode ran out of memory part-way: drop the
+        // elements not enqueued
+        Node* node = first;
+        for (size_t i = 0; i < n; i++) {
+            Node* next = atomic_load_explicit(&node->next, memory_order_relaxed);
+            if (i >= enqueued) {
+                node_destroy(queue, node);
+            }
+            node = next;
+        }
+        return false;
+    }
+    return true;
+}
+
+// Register the function that releases owned payloads left in the queue
+void queue_set_destructor(Queue* queue, void (*destructor)(void* data, size_t length)) {
+    if (queue != NULL) {
+        queue->destructor = destructor;
+        for (size_t i = 0; i < QUEUE_PRIORITY_LEVELS; i++) {
+            queue_set_destructor(queue->levels[i], destructor);
+        }
+    }
+}
+
+// Select how MPMC retry loops wait after a failed CAS (NULL restores BACKOFF_NONE)
+// Call before the queue is shared; returns false for an invalid configuration
+bool queue_set_backoff(Queue* queue, const BackoffConfig* config) {
+    if (queue == NULL) {
+        return false;
+    }
+    if (config == NULL) {
+        queue->backoff = backoff_config_default(BACKOFF_NONE);
+        for (size_t i = 0; i < QUEUE_PRIORITY_LEVELS; i++) {
+            queue_set_backoff(queue->levels[i], NULL);
+        }
+        return true;
+    }
+    if (!backoff_config_valid(config)) {
+        return false;
+    }
+    queue->backoff = *config;
+    for (size_t i = 0; i < QUEUE_PRIORITY_LEVELS; i++) {
+        queue_set_backoff(queue->levels[i], config);
+    }
+    return true;
+}
+
+// Give the queue an overflow tier of memory-mapped files in directory
+// Once high_water elements are in memory, new elements are appended to the
+// spill log instead of the list; consumers move them back, in FIFO order,
+// whenever the list holds no more than low_water. Call before the queue is
+// shared; the tier stays until the queue is destroyed. Elements enqueued
+// above the lowest priority level skip the tier.
+// SPSC queues are refused: a refill links at the tail from the consumer, and
+// an SPSC tail only takes plain stores from its one producer.
+bool queue_set_spill(Queue* queue, const char* directory, size_t high_water, size_t low_water) {
+    if (queue == NULL || directory == NULL || queue->spill != NULL || low_water >= high_water ||
+        queue->mode == QUEUE_MODE_SPSC) {
+        return false;
+    }
+    
+    QueueSpill* spill = (QueueSpill*)queue_mem_alloc_aligned(_Alignof(QueueSpill), sizeof(QueueSpill));
+    if (spill == NULL) {
+        return false;
+    }
+    spill->log = spill_open(directory, 0);
+    if (spill->log == NULL) {
+        queue_mem_free_aligned(spill);
+        return false;
+    }
+    spill->high_water = high_water;
+    spill->low_water = low_water;
+    atomic_init(&spill->state, 0);
+    atomic_init(&spill->finished, 0);
+    atomic_flag_clear(&spill->draining);
+    queue->spill = spill;
+    return true;
+}
+
+// Give the queue an arena for payload copies (chunk_bytes per chunk, 0: default)
+// Payloads too large to live inside their node are then carved from the
+// arena instead of malloc'd one by one, and queue_dequeue_view() hands them
+// out in place. The memory comes back all at once with queue_reset_arena().
+// Call before the queue is shared; the arena stays until the queue is destroyed.
+bool queue_set_arena(Queue* queue, size_t chunk_bytes) {
+    if (queue == NULL || queue->arena != NULL) {
+        return false;
+    }
+    queue->arena = arena_create(chunk_bytes);
+    return queue->arena != NULL;
+}
+
+// Release every payload in the queue's arena at once
+// All views handed out by queue_dequeue_view() become invalid. Call only
+// between phases: the queue must be empty and no other thread may be using
+// it. Returns false (and releases nothing) if there is no arena or the
+// queue still holds elements.
+bool queue_reset_arena(Queue* queue) {
+    if (queue == NULL || queue->arena == NULL || !queue_is_empty(queue)) {
+        return false;
+    }
+    arena_reset(queue->arena);
+    return true;
+}
+
+// Payload handoff shared by every dequeue path
+// With buffer != NULL the payload is copied into it and payloads larger than
+// capacity are left in the queue (*length reports the size needed). In view
+// mode (arena != NULL) *data points into the arena: arena payloads are handed
+// out where they are, others are copied into an arena block first. Otherwise
+// the payload is handed over in *data: heap payloads directly, inline and
+// arena ones as a fresh copy allocated before the element is unlinked so it
+// cannot be lost.
+// An optional predicate gets to look at the element before it is claimed; a
+// heap payload is pinned while it does (see payload_pin).
+typedef struct PayloadTarget {
+    void* buffer;            // Caller buffer (copy mode) or NULL (handoff mode)
+    size_t capacity;         // Size of buffer
+    void* copy;              // Handoff mode: preallocated copy for inline payloads
+    size_t copy_capacity;
+    bool (*pred)(const void* data, size_t length, void* ctx);  // Claim only if this passes (NULL: always)
+    void* ctx;               // Passed to pred
+    bool held;               // Set when an element was found but left queued
+    bool moved;              // Set when the element was claimed by another consumer while pred ran
+    bool owned;              // Set when *data is a buffer handed over with queue_enqueue_owned
+    PayloadArena* arena;     // View mode: payloads are handed out in place in this arena
+} PayloadTarget;
+
+// Check, before claiming node, that its payload can be delivered
+// A linked node's payload never changes, so this still holds after the claim.
+// slot and expected tell the predicate's pin what holds node in place (slot
+// NULL: the caller is the only consumer); if it has been claimed meanwhile,
+// target->moved is set and the caller looks again.
+static bool payload_prepare(Queue* queue, PayloadTarget* target, _Atomic(Node*)* slot, Node* expected,
+                            const Node* node, size_t* length) {
+    if (target->pred != NULL) {
+        bool pinned = slot != NULL && node_payload_heap(node);
+        if (pinned && !payload_pin(queue, slot, expected)) {
+            target->moved = true;
+            return false;
+        }
+        bool accepted = target->pred(node_payload(node), node->length, target->ctx);
+        if (pinned) {
+            payload_unpin(queue);
+        }
+        if (!accepted) {
+            *length = node->length;
+            target->held = true;
+            return false;
+        }
+    }
+    if (target->buffer != NULL) {
+        if (node->length > target->capacity) {
+            *length = node->length;
+            target->held = true;
+            return false;
+        }
+    } else if (target->arena != NULL) {
+        if (!(node->flags & NODE_ARENA) && node->length > target->copy_capacity) {
+            void* block = arena_alloc(target->arena, node->length);
+            if (block == NULL) {
+                *length = 0;
+                target->held = true;
+                return false;
+            }
+            target->copy = block;  // A smaller block left behind is reclaimed with the arena
+            target->copy_capacity = node->length;
+        }
+    } else if ((node->flags & NODE_COPY_OUT) && node->length > target->copy_capacity) {
+        void* grown = realloc(target->copy, node->length);
+        if (grown == NULL) {
+            *length = 0;
+            target->held = true;
+            return false;
+        }
+        target->copy = grown;
+        target->copy_capacity = node->length;
+    }
+    return true;
+}
+
+// Deliver the payload of a node we have claimed
+static void payload_take(Queue* queue, PayloadTarget* target, Node* node, void** data, size_t* length) {
+    if (node_payload_heap(node)) {
+        payload_settle(queue);
+    }
+    node_trace_dequeued(queue, node);
+    *length = node->length;
+    target->owned = false;
+    if (target->buffer != NULL) {
+        if (node->length > 0) {
+            memcpy(target->buffer, node_payload(node), node->length);
+            if (!(node->flags & NODE_INLINE)) {
+                payload_release(queue, node);
+            }
+        }
+    } else if (target->arena != NULL && (node->flags & NODE_ARENA)) {
+        *data = node->payload.data;
+    } else if (target->arena != NULL || (node->flags & NODE_COPY_OUT)) {
+        if (node->length > 0) {
+            memcpy(target->copy, node_payload(node), node->length);
+            if (!(node->flags & NODE_COPY_OUT)) {
+                payload_release(queue, node);  // View of a heap payload: the arena copy replaces it
+            }
+        }
+        *data = (node->length > 0) ? target->copy : NULL;
+        target->copy = NULL;
+        target->copy_capacity = 0;
+    } else {
+        *data = node->payload.data;
+        target->owned = (node->flags & NODE_OWNED) != 0;
+    }
+}
+
+// MPMC: unlink the first element (lock-free with retry)
+static bool mpmc_dequeue(Queue* queue, PayloadTarget* target, void** data, size_t* length) {
+    Backoff backoff;
+    backoff_init(&backoff, &queue->backoff);
+    
+    // Nodes we read may be dequeued concurrently; the critical section keeps
+    // them alive until we are done
+    reclaim_enter();
+    
+    // Lock-free dequeue with retry loop
+    while (true) {
+        Node* head = atomic_load_explicit(&queue->head, memory_order_acquire);
+        Node* tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        Node* first_node = atomic_load_explicit(&head->next, memory_order_acquire);
+        
+        // Check if queue is empty (dummy has no successor)
+        if (first_node == NULL) {
+            reclaim_exit();
+            *length = 0;
+            return false;
+        }
+        
+        if (head == tail) {
+            // Tail is lagging behind a completed link: help it forward before
+            // moving head past it
+            atomic_compare_exchange_strong_explicit(&queue->tail, &tail, first_node,
+                                                    memory_order_release,
+                                                    memory_order_relaxed);
+            QUEUE_STAT_RETRY(queue, dequeue_retries);
+            continue;
+        }
+        
+        if (!payload_prepare(queue, target, &queue->head, head, first_node, length)) {
+            if (target->moved) {
+                target->moved = false;
+                continue;
+            }
+            reclaim_exit();
+            return false;
+        }
+        
+        // Try to make first_node the new dummy (seq_cst: see payload_pin)
+        Node* expected = head;
+        if (atomic_compare_exchange_strong_explicit(&queue->head, &expected, first_node,
+                                                    memory_order_seq_cst,
+                                                    memory_order_acquire)) {
+            // We own first_node's payload now; the node itself stays on as the dummy
+            payload_take(queue, target, first_node, data, length);
+            node_set_prev(first_node, NULL);
+            
+            // The old dummy is unreachable but may still be read by concurrent
+            // threads; recycle it once they have all moved on
+            reclaim_retire(head, node_reclaim);
+            reclaim_exit();
+            backoff_done(&backoff);
+            
+            ticket_add(&queue->dequeue_ticket, 1);
+            
+            // Increment dequeue counter - element has been successfully removed from the queue
+            QUEUE_STAT_ADD(queue, dequeued, 1);
+            return true;
+        }
+        
+        // CAS failed - another thread dequeued first, retry
+        // This is the key to lock-freedom: we retry instead of blocking
+        // Increment retry counter
+        QUEUE_STAT_RETRY(queue, dequeue_retries);
+        contention_wait(&backoff);
+    }
+}
+
+// MPSC/SPSC: the only consumer owns head, so no CAS is needed
+static bool single_dequeue(Queue* queue, PayloadTarget* target, void** data, size_t* length) {
+    Node* head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    Node* first_node = atomic_load_explicit(&head->next, memory_order_acquire);
+    
+    // Empty, or (MPSC) the next producer has swapped the tail but not linked yet
+    if (first_node == NULL) {
+        *length = 0;
+        return false;
+    }
+    
+    if (!payload_prepare(queue, target, NULL, NULL, first_node, length)) {
+        return false;
+    }
+    
+    payload_take(queue, target, first_node, data, length);
+    node_set_prev(first_node, NULL);
+    atomic_store_explicit(&queue->head, first_node, memory_order_release);
+    
+    // Producers are done with the old dummy once its next is set; observers
+    // such as queue_is_empty may still be looking at it
+    reclaim_retire(head, node_reclaim);
+    
+    ticket_add_single(&queue->dequeue_ticket, 1);
+    QUEUE_STAT_ADD(queue, dequeued, 1);
+    return true;
+}
+
+// SEGMENT: move head_segment past a segment whose cells have all been claimed
+// Returns false if it is the newest segment (the queue is empty)
+static bool segment_advance_head(QueueSegment* segment, Queue* queue) {
+    QueueSegment* next = atomic_load_explicit(&segment->next, memory_order_acquire);
+    if (next == NULL) {
+        return false;
+    }
+    
+    // Never let head pass a lagging tail, or producers could still load the
+    // retired segment from tail_segment
+    QueueSegment* tail = segment;
+    atomic_compare_exchange_strong_explicit(&queue->tail_segment, &tail, next,
+                                            memory_order_release,
+                                            memory_order_relaxed);
+    
+    if (atomic_compare_exchange_strong_explicit(&queue->head_segment, &segment, next,
+                                                memory_order_acq_rel,
+                                                memory_order_relaxed)) {
+        // Consumers that claimed its last cells may still be taking them
+        reclaim_retire(segment, segment_reclaim);
+    }
+    return true;
+}
+
+// SEGMENT: take the payload of a claimed node and recycle the node
+static void segment_take(Queue* queue, PayloadTarget* target, Node* node, void** data, size_t* length) {
+    payload_take(queue, target, node, data, length);
+    reclaim_retire(node, node_reclaim);  // queue_print may still be reading it
+    
+    ticket_add(&queue->dequeue_ticket, 1);
+    QUEUE_STAT_ADD(queue, dequeued, 1);
+}
+
+// SEGMENT handoff: per-thread spare buffer for an inline payload
+// The fetch-and-add claim cannot be undone, so the buffer an inline payload is
+// copied into has to exist before the claim. Each thread keeps one spare and
+// only allocates a new one after an inline payload has been handed out in it,
+// so empty cells and heap payloads cost no allocation.
+static _Thread_local void* handoff_spare = NULL;
+static _Thread_local bool handoff_registered = false;
+static pthread_key_t handoff_key;
+static pthread_once_t handoff_key_once = PTHREAD_ONCE_INIT;
+
+// Thread exit: free the spare
+static void handoff_spare_release(void* arg) {
+    (void)arg;
+    free(handoff_spare);
+    handoff_spare = NULL;
+    handoff_registered = false;
+}
+
+static void handoff_key_create(void) {
+    pthread_key_create(&handoff_key, handoff_spare_release);
+}
+
+// The calling thread's spare, allocated if needed (NULL if out of memory)
+static void* handoff_spare_get(void) {
+    if (handoff_spare == NULL) {
+        if (!handoff_registered) {
+            pthread_once(&handoff_key_once, handoff_key_create);
+            pthread_setspecific(handoff_key, &handoff_spare);
+            handoff_registered = true;
+        }
+        handoff_spare = malloc(QUEUE_INLINE_MAX);
+    }
+    return handoff_spare;
+}
+
+// SEGMENT: claim the oldest element with fetch-and-add (handoff mode)
+// The claim cannot be undone, so nothing may be allocated after it: an inline
+// payload is copied into the thread's spare, which exists before the claim and
+// fits any inline payload, and a heap payload is handed over as is. Arena
+// payloads may need a copy of any size, so target_dequeue sends arena queues
+// to segment_dequeue_inspect instead.
+static bool segment_dequeue_handoff(Queue* queue, PayloadTarget* target, void** data, size_t* length) {
+    *length = 0;
+    reclaim_enter();
+    while (true) {
+        QueueSegment* segment = atomic_load_explicit(&queue->head_segment, memory_order_acquire);
+        size_t dequeue_index = atomic_load_explicit(&segment->dequeue_index, memory_order_acquire);
+        size_t enqueue_index = atomic_load_explicit(&segment->enqueue_index, memory_order_acquire);
+        if (dequeue_index >= enqueue_index &&
+            atomic_load_explicit(&segment->next, memory_order_acquire) == NULL) {
+            reclaim_exit();
+            return false;  // Every cell handed out so far has been claimed
+        }
+        
+        if (QUEUE_INLINE_MAX > 0 && handoff_spare_get() == NULL) {
+            reclaim_exit();
+            return false;
+        }
+        
+        size_t index = atomic_fetch_add_explicit(&segment->dequeue_index, 1, memory_order_relaxed);
+        if (index >= QUEUE_SEGMENT_SIZE) {
+            if (!segment_advance_head(segment, queue)) {
+                reclaim_exit();
+                return false;
+            }
+            continue;
+        }
+        
+        // A NULL result means the producer has not published yet; the cell
+        // is poisoned and that producer moves on to another one. SEGMENT_TAKEN
+        // means a copy-mode consumer claimed the cell first.
+        Node* node = atomic_exchange_explicit(&segment->cells[index], SEGMENT_TAKEN, memory_order_seq_cst);
+        if (node == NULL || node == SEGMENT_TAKEN) {
+            QUEUE_STAT_RETRY(queue, dequeue_retries);
+            continue;
+        }
+        
+        if (QUEUE_INLINE_MAX > 0 && (node->flags & NODE_INLINE)) {
+            target->copy = handoff_spare;  // Handed out with the payload
+            target->copy_capacity = QUEUE_INLINE_MAX;
+            handoff_spare = NULL;
+        }
+        segment_take(queue, target, node, data, length);
+        reclaim_exit();
+        return true;
+    }
+}
+
+// SEGMENT: claim the oldest element only if payload_prepare accepts it
+// (copy mode, or a predicate). The cell at dequeue_index is inspected and
+// claimed with a CAS, so an element that does not fit or is rejected stays queued
+static bool segment_dequeue_inspect(Queue* queue, PayloadTarget* target, void** data, size_t* length) {
+    reclaim_enter();
+    while (true) {
+        QueueSegment* segment = atomic_load_explicit(&queue->head_segment, memory_order_acquire);
+        size_t index = atomic_load_explicit(&segment->dequeue_index, memory_order_acquire);
+        if (index >= QUEUE_SEGMENT_SIZE) {
+            if (!segment_advance_head(segment, queue)) {
+                reclaim_exit();
+                *length = 0;
+                return false;
+            }
+            continue;
+        }
+        
+        Node* node = atomic_load_explicit(&segment->cells[index], memory_order_acquire);
+        if (node == NULL) {
+            if (index >= atomic_load_explicit(&segment->enqueue_index, memory_order_acquire)) {
+                reclaim_exit();
+                *length = 0;
+                return false;
+            }
+            // Claimed by a producer that has not published yet: poison it
+            Node* expected = NULL;
+            atomic_compare_exchange_strong_explicit(&segment->cells[index], &expected, SEGMENT_TAKEN,
+                                                    memory_order_acq_rel,
+                                                    memory_order_acquire);
+            continue;
+        }
+        if (node == SEGMENT_TAKEN) {
+            // Claimed already; help dequeue_index past it
+            atomic_compare_exchange_strong_explicit(&segment->dequeue_index, &index, index + 1,
+                                                    memory_order_acq_rel,
+                                                    memory_order_relaxed);
+            continue;
+        }
+        
+        if (!payload_prepare(queue, target, &segment->cells[index], node, node, length)) {
+            if (target->moved) {
+                target->moved = false;
+                continue;
+            }
+            reclaim_exit();
+            return false;
+        }
+        
+        Node* expected = node;
+        if (atomic_compare_exchange_strong_explicit(&segment->cells[index], &expected, SEGMENT_TAKEN,
+                                                    memory_order_seq_cst,
+                                                    memory_order_acquire)) {
+            atomic_compare_exchange_strong_explicit(&segment->dequeue_index, &index, index + 1,
+                                                    memory_order_acq_rel,
+                                                    memory_order_relaxed);
+            segment_take(queue, target, node, data, length);
+            reclaim_exit();
+            return true;
+        }
+        QUEUE_STAT_RETRY(queue, dequeue_retries);
+    }
+}
+
+// PRIORITY: most urgent level whose bit is set in mask (mask must not be 0)
+static inline unsigned int priority_first(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned int)index;
+#else
+    return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+
+// PRIORITY: clear the bit of a level a dequeue found empty
+// A producer may have enqueued after that dequeue while the bit was still
+// set, so look again after clearing it and put the bit back if needed
+static void priority_clear(Queue* queue, unsigned int priority) {
+    unsigned int bit = 1u << priority;
+    atomic_fetch_and_explicit(&queue->level_mask, ~bit, memory_order_seq_cst);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!queue_is_empty(queue->levels[priority])) {
+        atomic_fetch_or_explicit(&queue->level_mask, bit, memory_order_seq_cst);
+    }
+}
+
+static bool target_dequeue(Queue* queue, PayloadTarget* target, void** data, size_t* length);
+
+// PRIORITY: dequeue from the most urgent non-empty level
+// The level mask is read instead of scanning every level; a bit that is set
+// for a level that has just been drained costs one failed attempt
+static bool priority_dequeue(Queue* queue, PayloadTarget* target, void** data, size_t* length) {
+    while (true) {
+        unsigned int mask = atomic_load_explicit(&queue->level_mask, memory_order_acquire);
+        if (mask == 0) {
+            *length = 0;
+            return false;
+        }
+        
+        unsigned int priority = priority_first(mask);
+        if (target_dequeue(queue->levels[priority], target, data, length)) {
+            return true;
+        }
+        if (target->held) {
+            return false;  // The level's first element stays (too large, rejected, or no memory)
+        }
+        priority_clear(queue, priority);
+    }
+}
+
+// Unlink the first element using the queue's mode
+// Move spilled elements back into the list once it holds no more than the
+// low-water mark, and switch the tier off when the log has been emptied
+// One consumer refills at a time; the others carry on without waiting
+static void spill_refill(Queue* queue) {
+    QueueSpill* spill = queue->spill;
+    if (!(atomic_load_explicit(&spill->state, memory_order_acquire) & SPILL_ACTIVE)) {
+        return;
+    }
+    size_t size = list_size(queue);
+    if (size > spill->low_water ||
+        atomic_flag_test_and_set_explicit(&spill->draining, memory_order_acquire)) {
+        return;
+    }
+    
+    // Refill up to the high-water mark, oldest first
+    size_t room = spill->high_water - size;
+    size_t moved = 0;
+    uint32_t flags;
+    const void* data;
+    size_t length;
+    while (moved < room && spill_peek(spill->log, &flags, &data, &length)) {
+        Node* node;
+        if (flags & NODE_OWNED) {
+            const SpilledOwned* owned = (const SpilledOwned*)data;
+            node = node_create_owned(queue, owned->data, (size_t)owned->length);
+        } else {
+            node = node_create(queue, data, length);
+        }
+        if (node == NULL) {
+            break;
+        }
+        if (list_link(queue, node, node, 1) == 0) {
+            // SEGMENT mode out of memory: the record stays in the log
+            if (flags & NODE_OWNED) {
+                node_pool_free(node);
+            } else {
+                node_destroy(queue, node);
+            }
+            break;
+        }
+        spill_pop(spill->log);
+        moved++;
+    }
+    if (moved > 0) {
+        eventcount_notify(&queue->not_empty, moved > 1);
+    }
+    
+    // Switch off only if every registered append has finished and was drained
+    uint_fast64_t state = atomic_load_explicit(&spill->state, memory_order_acquire);
+    if ((state & SPILL_ACTIVE) &&
+        atomic_load_explicit(&spill->finished, memory_order_acquire) == (state >> 1) &&
+        spill_count(spill->log) == 0) {
+        atomic_compare_exchange_strong_explicit(&spill->state, &state, state & ~(uint_fast64_t)SPILL_ACTIVE,
+                                                memory_order_acq_rel,
+                                                memory_order_relaxed);
+    }
+    atomic_flag_clear_explicit(&spill->draining, memory_order_release);
+}
+
+static bool target_dequeue(Queue* queue, PayloadTarget* target, void** data, size_t* length) {
+    if (queue->spill != NULL) {
+        spill_refill(queue);
+    }
+    switch (queue->mode) {
+        case QUEUE_MODE_MPMC:
+            return mpmc_dequeue(queue, target, data, length);
+        case QUEUE_MODE_SEGMENT:
+            // The fetch-and-add claim cannot be undone, so anything that may
+            // leave the element queued has to inspect it first (and so does
+            // a handoff that may need to copy an arena payload of any size)
+            return (target->buffer != NULL || target->pred != NULL || queue->arena != NULL)
+                   ? segment_dequeue_inspect(queue, target, data, length)
+                   : segment_dequeue_handoff(queue, target, data, length);
+        case QUEUE_MODE_PRIORITY:
+            return priority_dequeue(queue, target, data, length);
+        default:
+            return single_dequeue(queue, target, data, length);
+    }
+}
+
+// Unlink the first element into buffer (copy mode) or *data (handoff mode)
+// *owned (if not NULL) tells whether a handed-off *data was enqueued owned
+static bool list_dequeue(Queue* queue, void* buffer, size_t capacity, void** data, size_t* length,
+                         bool* owned) {
+    PayloadTarget target = { buffer, capacity, NULL, 0, NULL, NULL, false, false, false, NULL };
+    bool dequeued = target_dequeue(queue, &target, data, length);
+    if (owned != NULL) {
+        *owned = dequeued && target.owned;
+    }
+    free(target.copy);  // Only still set if the copy went unused
+    QUEUE_TRACE_OP_END(queue, dequeue_retry_ops);
+    return dequeued;
+}
+
+// Batch dequeue slots double as scratch space: until the batch is claimed,
+// out[i] holds a preallocated copy buffer for inline payloads and lens[i] its
+// capacity, so a failed claim can reuse them on the next attempt
+static bool batch_prepare(const Node* node, void** out, size_t* lens, size_t i) {
+    if ((node->flags & NODE_COPY_OUT) && node->length > lens[i]) {
+        void* grown = realloc(out[i], node->length);
+        if (grown == NULL) {
+            return false;
+        }
+        out[i] = grown;
+        lens[i] = node->length;
+    }
+    return true;
+}
+
+// Hand over the payloads of the count nodes after dummy, then release any
+// scratch buffers in slots [count, prepared)
+// owned[i] (if owned is not NULL) is set when out[i] was enqueued owned
+static void batch_take(Queue* queue, Node* dummy, void** out, size_t* lens, bool* owned, size_t count,
+                       size_t prepared) {
+    Node* node = dummy;
+    for (size_t i = 0; i < count; i++) {
+        node = atomic_load_explicit(&node->next, memory_order_acquire);
+        node_trace_dequeued(queue, node);
+        if (node->flags & NODE_COPY_OUT) {
+            memcpy(out[i], node_payload(node), node->length);
+        } else {
+            free(out[i]);
+            out[i] = node->payload.data;
+        }
+        if (owned != NULL) {
+            owned[i] = (node->flags & NODE_OWNED) != 0;
+        }
+        lens[i] = node->length;
+        node_set_prev(node, NULL);
+    }
+    for (size_t i = count; i < prepared; i++) {
+        free(out[i]);
+    }
+}
+
+// Walk up to max elements from head, preparing their slots
+// Stops at the tail (head must never pass it) and when a copy cannot be
+// allocated; returns the number of elements collected and their last node
+static size_t batch_collect(Node* head, Node* tail, void** out, size_t* lens, size_t max,
+                            size_t* prepared, Node** last) {
+    Node* node = head;
+    size_t count = 0;
+    while (count < max && (count == 0 || node != tail)) {
+        Node* next = atomic_load_explicit(&node->next, memory_order_acquire);
+        if (next == NULL) {
+            break;
+        }
+        if (count == *prepared) {
+            out[count] = NULL;
+            lens[count] = 0;
+            (*prepared)++;
+        }
+        if (!batch_prepare(next, out, lens, count)) {
+            break;
+        }
+        node = next;
+        count++;
+    }
+    *last = node;
+    return count;
+}
+
+// MPMC: detach up to max elements with a single CAS on head
+static size_t mpmc_dequeue_batch(Queue* queue, void** out, size_t* lens, bool* owned, size_t max) {
+    size_t prepared = 0;
+    Backoff backoff;
+    backoff_init(&backoff, &queue->backoff);
+    
+    reclaim_enter();
+    
+    while (true) {
+        Node* head = atomic_load_explicit(&queue->head, memory_order_acquire);
+        Node* tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+        Node* first_node = atomic_load_explicit(&head->next, memory_order_acquire);
+        
+        if (first_node != NULL && head == tail) {
+            // Tail is lagging behind a completed link: help it forward first
+            atomic_compare_exchange_strong_explicit(&queue->tail, &tail, first_node,
+                                                    memory_order_release,
+                                                    memory_order_relaxed);
+            QUEUE_STAT_RETRY(queue, dequeue_retries);
+            continue;
+        }
+        
+        Node* last;
+        size_t count = batch_collect(head, tail, out, lens, max, &prepared, &last);
+        if (count == 0) {
+            reclaim_exit();
+            batch_take(queue, head, out, lens, NULL, 0, prepared);
+            return 0;
+        }
+        
+        // Make the last collected node the new dummy, detaching the whole run
+        Node* expected = head;
+        if (atomic_compare_exchange_strong_explicit(&queue->head, &expected, last,
+                                                    memory_order_seq_cst,
+                                                    memory_order_acquire)) {
+            payload_settle(queue);  // A peek may be reading the first payload (see payload_pin)
+            batch_take(queue, head, out, lens, owned, count, prepared);
+            
+            // Retire the old dummy and every detached node except the new dummy
+            Node* node = head;
+            for (size_t i = 0; i < count; i++) {
+                Node* next = atomic_load_explicit(&node->next, memory_order_relaxed);
+                reclaim_retire(node, node_reclaim);
+                node = next;
+            }
+            reclaim_exit();
+            backoff_done(&backoff);
+            
+            ticket_add(&queue->dequeue_ticket, count);
+            QUEUE_STAT_ADD(queue, dequeued, count);
+            return count;
+        }
+        
+        // CAS failed - another consumer moved head, collect again
+        QUEUE_STAT_RETRY(queue, dequeue_retries);
+        contention_wait(&backoff);
+    }
+}
+
+// MPSC/SPSC: the only consumer walks and advances head directly
+static size_t single_dequeue_batch(Queue* queue, void** out, size_t* lens, bool* owned, size_t max) {
+    size_t prepared = 0;
+    Node* head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    Node* last;
+    size_t count = batch_collect(head, NULL, out, lens, max, &prepared, &last);
+    
+    batch_take(queue, head, out, lens, owned, count, prepared);
+    if (count == 0) {
+        return 0;
+    }
+    atomic_store_explicit(&queue->head, last, memory_order_release);
+    
+    Node* node = head;
+    for (size_t i = 0; i < count; i++) {
+        Node* next = atomic_load_explicit(&node->next, memory_order_relaxed);
+        reclaim_retire(node, node_reclaim);
+        node = next;
+    }
+    
+    ticket_add_single(&queue->dequeue_ticket, count);
+    QUEUE_STAT_ADD(queue, dequeued, count);
+    return count;
+}
+
+// Dequeue up to max elements into out/lens, and into owned if not NULL
+static size_t dequeue_batch(Queue* queue, void** out, size_t* lens, bool* owned, size_t max) {
+    if (queue->spill != NULL) {
+        spill_refill(queue);
+    }
+    size_t count = 0;
+    switch (queue->mode) {
+        case QUEUE_MODE_MPMC:
+            count = mpmc_dequeue_batch(queue, out, lens, owned, max);
+            break;
+        case QUEUE_MODE_SEGMENT:
+            // Cells are claimed one at a time anyway; no single-CAS detach to
+            // batch (and each claim is traced as a dequeue of its own)
+            while (count < max && list_dequeue(queue, NULL, 0, &out[count], &lens[count],
+                                               owned != NULL ? &owned[count] : NULL)) {
+                count++;
+            }
+            return count;
+        case QUEUE_MODE_PRIORITY:
+            // Detach runs from the most urgent level first, moving on to the
+            // next level only once it is drained
+            while (count < max) {
+                unsigned int mask = atomic_load_explicit(&queue->level_mask, memory_order_acquire);
+                if (mask == 0) {
+                    break;
+                }
+                unsigned int priority = priority_first(mask);
+                size_t taken = mpmc_dequeue_batch(queue->levels[priority], &out[count], &lens[count],
+                                                  owned != NULL ? &owned[count] : NULL, max - count);
+                if (taken == 0) {
+                    priority_clear(queue, priority);
+                }
+                count += taken;
+            }
+            break;
+        default:
+            count = single_dequeue_batch(queue, out, lens, owned, max);
+            break;
+    }
+    QUEUE_TRACE_OP_END(queue, dequeue_retry_ops);
+    return count;
+}
+
+// Dequeue up to max elements from the head in one operation
+// Element i is returned in out[i] / lens[i] under the same rules as
+// queue_dequeue (the caller frees each out[i]). Returns the number dequeued.
+size_t queue_dequeue_batch(Queue* queue, void** out, size_t* lens, size_t max) {
+    if (queue == NULL || out == NULL || lens == NULL || max == 0) {
+        return 0;
+    }
+    return dequeue_batch(queue, out, lens, NULL, max);
+}
+
+// Dequeue up to max elements as queue_dequeue_batch, and report in owned[i]
+// whether out[i] is a buffer handed over with queue_enqueue_owned (release it
+// as the queue's destructor would) rather than a copy the caller frees
+size_t queue_dequeue_batch_owned(Queue* queue, void** out, size_t* lens, bool* owned, size_t max) {
+    if (queue == NULL || out == NULL || lens == NULL || owned == NULL || max == 0) {
+        return 0;
+    }
+    return dequeue_batch(queue, out, lens, owned, max);
+}
+
+// Dequeue an element from the head (caller must free the returned data)
+bool queue_dequeue(Queue* queue, void** data, size_t* length) {
+    if (queue == NULL || data == NULL || length == NULL) {
+        return false;
+    }
+    return list_dequeue(queue, NULL, 0, data, length, NULL);
+}
+
+// Dequeue an element, waiting up to timeout_ns nanoseconds for one to arrive
+// (0 does not wait, QUEUE_WAIT_FOREVER waits indefinitely)
+// The caller spins briefly first, then sleeps until an enqueue wakes it.
+// Returns QUEUE_WAIT_CLOSED instead of waiting once the queue is closed and
+// drained, so a consumer can loop until then without a timeout.
+QueueWaitStatus queue_dequeue_wait(Queue* queue, void** data, size_t* length, uint64_t timeout_ns) {
+    if (queue == NULL || data == NULL || length == NULL) {
+        return QUEUE_WAIT_TIMEOUT;
+    }
+    
+    if (list_dequeue(queue, NULL, 0, data, length, NULL)) {
+        return QUEUE_WAIT_OK;
+    }
+    if (queue_drained(queue)) {
+        return QUEUE_WAIT_CLOSED;
+    }
+    if (timeout_ns == 0) {
+        return QUEUE_WAIT_TIMEOUT;
+    }
+    
+    uint64_t deadline = QUEUE_WAIT_FOREVER;
+    if (timeout_ns != QUEUE_WAIT_FOREVER) {
+        uint64_t now = eventcount_now_ns();
+        deadline = timeout_ns < QUEUE_WAIT_FOREVER - now ? now + timeout_ns : QUEUE_WAIT_FOREVER - 1;
+    }
+    
+    // An element that arrives within a short spin is picked up without a
+    // system call on either side
+    for (unsigned int i = 0; i < QUEUE_WAIT_SPINS; i++) {
+        backoff_cpu_relax();
+        if (!queue_is_empty(queue) && list_dequeue(queue, NULL, 0, data, length, NULL)) {
+            return QUEUE_WAIT_OK;
+        }
+    }
+    
+    while (true) {
+        // Announce the wait before the last check, so an enqueue (or a close)
+        // that lands after the check is guaranteed to see us and wake us
+        uint32_t key = eventcount_prepare_wait(&queue->not_empty);
+        if (list_dequeue(queue, NULL, 0, data, length, NULL)) {
+            eventcount_cancel_wait(&queue->not_empty);
+            return QUEUE_WAIT_OK;
+        }
+        
+        // Closed: the last elements are in the hands of other consumers, or
+        // will be dequeued next; either way nothing will wake us, so spin
+        bool closed = atomic_load_explicit(&queue->closed, memory_order_acquire) == QUEUE_CLOSED;
+        if (closed && queue_is_empty(queue)) {
+            eventcount_cancel_wait(&queue->not_empty);
+            return QUEUE_WAIT_CLOSED;
+        }
+        
+        uint64_t remaining = QUEUE_WAIT_FOREVER;
+        if (deadline != QUEUE_WAIT_FOREVER) {
+            uint64_t now = eventcount_now_ns();
+            if (now >= deadline) {
+                eventcount_cancel_wait(&queue->not_empty);
+                return QUEUE_WAIT_TIMEOUT;
+            }
+            remaining = deadline - now;
+        }
+        if (closed) {
+            eventcount_cancel_wait(&queue->not_empty);
+            backoff_cpu_relax();
+            continue;
+        }
+        eventcount_wait(&queue->not_empty, key, remaining);
+    }
+}
+
+// Dequeue an element from the head, copying its payload into buffer
+// Returns false if the queue is empty (*length == 0) or if the first element
+// does not fit in capacity bytes (*length is the size needed; it stays queued)
+bool queue_dequeue_into(Queue* queue, void* buffer, size_t capacity, size_t* length) {
+    if (queue == NULL || length == NULL || (buffer == NULL && capacity > 0)) {
+        return false;
+    }
+    // A zero-capacity call still needs a non-NULL buffer to select copy mode
+    static unsigned char empty_buffer[1];
+    return list_dequeue(queue, buffer != NULL ? buffer : empty_buffer, capacity, NULL, length, NULL);
+}
+
+// Dequeue an element from the head without taking ownership of its payload
+// *data points into the queue's arena (payloads stored elsewhere are copied
+// there first) and stays valid until queue_reset_arena(); do not free it.
+// Returns false if the queue is empty or has no arena, or if the arena is
+// out of memory (*length == 0 in every case; the element stays queued).
+bool queue_dequeue_view(Queue* queue, const void** data, size_t* length) {
+    if (queue == NULL || data == NULL || length == NULL) {
+        return false;
+    }
+    *length = 0;
+    if (queue->arena == NULL) {
+        return false;
+    }
+    PayloadTarget target = { NULL, 0, NULL, 0, NULL, NULL, false, false, false, queue->arena };
+    void* view = NULL;
+    bool dequeued = target_dequeue(queue, &target, &view, length);
+    QUEUE_TRACE_OP_END(queue, dequeue_retry_ops);
+    if (!dequeued) {
+        return false;
+    }
+    *data = view;
+    return true;  // An unused arena block is reclaimed with the arena
+}
+
+// Dequeue the first element only if pred accepts it
+// pred sees the payload and its length before the element is claimed (and
+// again if another consumer takes that element first, so keep it cheap and
+// free of side effects). Returns false if the queue is empty (*length == 0)
+// or pred rejected the first element, which stays queued (*length is its size).
+// Data is handed over as with queue_dequeue. A heap payload is pinned while
+// pred reads it, and a consumer claiming it meanwhile waits for pred to return.
+bool queue_dequeue_if(Queue* queue, bool (*pred)(const void* data, size_t length, void* ctx), void* ctx,
+                      void** data, size_t* length) {
+    if (queue == NULL || pred == NULL || data == NULL || length == NULL) {
+        return false;
+    }
+    PayloadTarget target = { NULL, 0, NULL, 0, pred, ctx, false, false, false, NULL };
+    bool dequeued = target_dequeue(queue, &target, data, length);
+    free(target.copy);
+    QUEUE_TRACE_OP_END(queue, dequeue_retry_ops);
+    return dequeued;
+}
+
+// SEGMENT: oldest published element (call inside a critical section)
+// Cells whose producer has not published yet are skipped: a dequeue would
+// poison them and that producer would publish further on
+static Node* segment_first(Queue* queue, _Atomic(Node*)** slot) {
+    QueueSegment* segment = atomic_load_explicit(&queue->head_segment, memory_order_acquire);
+    for (; segment != NULL; segment = atomic_load_explicit(&segment->next, memory_order_acquire)) {
+        size_t end = atomic_load_explicit(&segment->enqueue_index, memory_order_acquire);
+        end = end < QUEUE_SEGMENT_SIZE ? end : QUEUE_SEGMENT_SIZE;
+        for (size_t i = atomic_load_explicit(&segment->dequeue_index, memory_order_acquire); i < end; i++) {
+            Node* node = atomic_load_explicit(&segment->cells[i], memory_order_acquire);
+            if (node != NULL && node != SEGMENT_TAKEN) {
+                *slot = &segment->cells[i];
+                return node;
+            }
+        }
+    }
+    return NULL;
+}
+
+// First element's node, or NULL if the queue is empty (call inside a critical section)
+// *owner, *slot and *expected receive what payload_pin needs: the queue (or
+// priority level) holding the node, and the head and dummy or the cell and node
+static Node* first_node(Queue* queue, Queue** owner, _Atomic(Node*)** slot, Node** expected) {
+    switch (queue->mode) {
+        case QUEUE_MODE_SEGMENT: {
+            Node* node = segment_first(queue, slot);
+            *owner = queue;
+            *expected = node;
+            return node;
+        }
+        case QUEUE_MODE_PRIORITY: {
+            unsigned int mask = atomic_load_explicit(&queue->level_mask, memory_order_acquire);
+            while (mask != 0) {
+                Node* node = first_node(queue->levels[priority_first(mask)], owner, slot, expected);
+                if (node != NULL) {
+                    return node;
+                }
+                mask &= mask - 1;
+            }
+            return NULL;
+        }
+        default: {
+            Node* head = atomic_load_explicit(&queue->head, memory_order_acquire);
+            *owner = queue;
+            *slot = &queue->head;
+            *expected = head;
+            return atomic_load_explicit(&head->next, memory_order_acquire);
+        }
+    }
+}
+
+// Copy the first element's payload into buffer without removing it
+// Returns false if the queue is empty (*length == 0) or the payload does not
+// fit in capacity bytes (*length is the size needed)
+// The node is protected by the reclamation scheme and a heap payload is
+// pinned while it is copied (see payload_pin), so any thread may peek at a
+// multi-consumer queue. MPSC and SPSC queues only pin against each other's
+// peeks: there, peek from the consumer thread.
+bool queue_peek(Queue* queue, void* buffer, size_t capacity, size_t* length) {
+    if (queue == NULL || length == NULL || (buffer == NULL && capacity > 0)) {
+        return false;
+    }
+    
+    if (queue->spill != NULL) {
+        spill_refill(queue);
+    }
+    
+    reclaim_enter();
+    bool copied = false;
+    while (true) {
+        Queue* owner;
+        _Atomic(Node*)* slot;
+        Node* expected;
+        Node* node = first_node(queue, &owner, &slot, &expected);
+        if (node == NULL) {
+            *length = 0;
+            break;
+        }
+        *length = node->length;
+        if (node->length > capacity) {
+            break;
+        }
+        bool pinned = node_payload_heap(node);
+        if (pinned && !payload_pin(owner, slot, expected)) {
+            continue;  // Dequeued meanwhile: look at the new first element
+        }
+        if (node->length > 0) {
+            memcpy(buffer, node_payload(node), node->length);
+        }
+        if (pinned) {
+            payload_unpin(owner);
+        }
+        copied = true;
+        break;
+    }
+    reclaim_exit();
+    return copied;
+}
+
+// SEGMENT: check whether any cell has been handed to a producer and not yet
+// claimed by a consumer (call inside a critical section)
+static bool segment_is_empty(Queue* queue) {
+    QueueSegment* segment = atomic_load_explicit(&queue->head_segment, memory_order_acquire);
+    while (segment != NULL) {
+        size_t dequeue_index = atomic_load_explicit(&segment->dequeue_index, memory_order_acquire);
+        size_t enqueue_index = atomic_load_explicit(&segment->enqueue_index, memory_order_acquire);
+        if (dequeue_index < enqueue_index && dequeue_index < QUEUE_SEGMENT_SIZE) {
+            return false;
+        }
+        segment = atomic_load_explicit(&segment->next, memory_order_acquire);
+    }
+    return true;
+}
+
+// Print one element for queue_print
+static void print_element(const Node* node, bool first, void (*print_func)(const void* data, size_t length)) {
+    if (!first) {
+        printf(", ");
+    }
+    
+    if (print_func != NULL) {
+        print_func(node_payload(node), node->length);
+    } else {
+        // Default: print address and length
+        printf("(ptr: %p, len: %zu)", node_payload(node), (size_t)node->length);
+    }
+}
+
+// Check if queue is empty
+bool queue_is_empty(Queue* queue) {
+    if (queue == NULL) {
+        return true;
+    }
+    if (queue->spill != NULL && spill_count(queue->spill->log) > 0) {
+        return false;
+    }
+    
+    if (queue->mode == QUEUE_MODE_PRIORITY) {
+        // Levels whose bit is clear are empty, or a producer is about to set it
+        unsigned int mask = atomic_load_explicit(&queue->level_mask, memory_order_acquire);
+        while (mask != 0) {
+            unsigned int priority = priority_first(mask);
+            if (!queue_is_empty(queue->levels[priority])) {
+                return false;
+            }
+            mask &= mask - 1;
+        }
+        return true;
+    }
+    
+    reclaim_enter();
+    bool empty;
+    if (queue->mode == QUEUE_MODE_SEGMENT) {
+        empty = segment_is_empty(queue);
+    } else {
+        Node* head = atomic_load_explicit(&queue->head, memory_order_acquire);
+        empty = atomic_load_explicit(&head->next, memory_order_acquire) == NULL;
+    }
+    reclaim_exit();
+    return empty;
+}
+
+// Get queue size (same as queue_size_approx)
+size_t queue_size(Queue* queue) {
+    return queue_size_approx(queue);
+}
+
+// Get the number of elements from the producer and consumer tickets (and
+// the spill log's counters)
+// A few loads and no writes; exact once every operation in flight has
+// finished, otherwise off by at most the number of operations in flight
+size_t queue_size_approx(Queue* queue) {
+    if (queue == NULL) {
+        return 0;
+    }
+    size_t size = list_size(queue);
+    if (queue->spill != NULL) {
+        size += spill_count(queue->spill->log);
+    }
+    return size;
+}
+
+// Count the linked elements of a list or segment queue (call inside a critical section)
+static size_t count_elements(Queue* queue) {
+    size_t count = 0;
+    if (queue->mode == QUEUE_MODE_SEGMENT) {
+        QueueSegment* segment = atomic_load_explicit(&queue->head_segment, memory_order_acquire);
+        for (; segment != NULL; segment = atomic_load_explicit(&segment->next, memory_order_acquire)) {
+            size_t end = atomic_load_explicit(&segment->enqueue_index, memory_order_acquire);
+            end = end < QUEUE_SEGMENT_SIZE ? end : QUEUE_SEGMENT_SIZE;
+            for (size_t i = atomic_load_explicit(&segment->dequeue_index, memory_order_acquire); i < end; i++) {
+                Node* node = atomic_load_explicit(&segment->cells[i], memory_order_acquire);
+                if (node != NULL && node != SEGMENT_TAKEN) {
+                    count++;
+                }
+            }
+        }
+    } else {
+        Node* head = atomic_load_explicit(&queue->head, memory_order_acquire);
+        Node* current = atomic_load_explicit(&head->next, memory_order_acquire);
+        while (current != NULL) {
+            count++;
+            current = atomic_load_explicit(&current->next, memory_order_acquire);
+        }
+    }
+    return count;
+}
+
+// Get the number of elements by walking the queue
+// O(n) and it reads every node; exact while no other thread is using the
+// queue, and under concurrency it counts what the walk happens to see
+size_t queue_size_exact(Queue* queue) {
+    if (queue == NULL) {
+        return 0;
+    }
+    size_t count = 0;
+    if (queue->mode == QUEUE_MODE_PRIORITY) {
+        for (size_t i = 0; i < QUEUE_PRIORITY_LEVELS; i++) {
+            count += queue_size_exact(queue->levels[i]);
+        }
+    } else {
+        reclaim_enter();
+        count = count_elements(queue);
+        reclaim_exit();
+    }
+    // Spilled elements are counted, not walked
+    if (queue->spill != NULL) {
+        count += spill_count(queue->spill->log);
+    }
+    return count;
+}
+
+// Print queue contents (for debugging)
+// If print_func is NULL, prints data address and length
+void queue_print(Queue* queue, void (*print_func)(const void* data, size_t length)) {
+    if (queue == NULL) {
+        printf("Queue is NULL\n");
+        return;
+    }
+    
+    printf("Queue (size: %zu): [", queue_size(queue));
+    
+    reclaim_enter();
+    bool first = true;
+    if (queue->mode == QUEUE_MODE_SEGMENT) {
+        QueueSegment* segment = atomic_load_explicit(&queue->head_segment, memory_order_acquire);
+        for (; segment != NULL; segment = atomic_load_explicit(&segment->next, memory_order_acquire)) {
+            size_t end = atomic_load_explicit(&segment->enqueue_index, memory_order_acquire);
+            end = end < QUEUE_SEGMENT_SIZE ? end : QUEUE_SEGMENT_SIZE;
+            for (size_t i = atomic_load_explicit(&segment->dequeue_index, memory_order_acquire); i < end; i++) {
+                Node* node = atomic_load_explicit(&segment->cells[i], memory_order_acquire);
+                if (node != NULL && node != SEGMENT_TAKEN) {
+                    print_element(node, first, print_func);
+                    first = false;
+                }
+            }
+        }
+    } else {
+        // Priority queues print their levels in dequeue order
+        bool priority = queue->mode == QUEUE_MODE_PRIORITY;
+        for (size_t i = 0; i < (priority ? QUEUE_PRIORITY_LEVELS : 1); i++) {
+            Queue* list = priority ? queue->levels[i] : queue;
+            Node* head = atomic_load_explicit(&list->head, memory_order_acquire);
+            Node* current = atomic_load_explicit(&head->next, memory_order_acquire);
+            while (current != NULL) {
+                print_element(current, first, print_func);
+                first = false;
+                current = atomic_load_explicit(&current->next, memory_order_acquire);
+            }
+        }
+    }
+    reclaim_exit();
+    
+    printf("]\n");
+}
+
+// Take a snapshot of the queue's statistics
+// Shards are summed without stopping other threads, so counters updated
+// concurrently may or may not be included
+bool queue_get_stats(Queue* queue, QueueStats* out) {
+    if (queue == NULL || out == NULL) {
+        return false;
+    }
+    
+    memset(out, 0, sizeof(QueueStats));
+    if (queue->mode == QUEUE_MODE_PRIORITY) {
+        // A priority queue's operations are counted by its levels
+        for (size_t i = 0; i < QUEUE_PRIORITY_LEVELS; i++) {
+            QueueStats level;
+            queue_get_stats(queue->levels[i], &level);
+            out->enqueued += level.enqueued;
+            out->dequeued += level.dequeued;
+            out->enqueue_retries += level.enqueue_retries;
+            out->dequeue_retries += level.dequeue_retries;
+            out->size += level.size;
+        }
+        return true;
+    }
+#ifndef QUEUE_NO_STATS
+    for (size_t i = 0; i < QUEUE_STAT_SHARDS; i++) {
+        QueueStatShard* shard = &queue->stats[i];
+        out->enqueued += atomic_load_explicit(&shard->enqueued, memory_order_relaxed);
+        out->dequeued += atomic_load_explicit(&shard->dequeued, memory_order_relaxed);
+        out->enqueue_retries += atomic_load_explicit(&shard->enqueue_retries, memory_order_relaxed);
+        out->dequeue_retries += atomic_load_explicit(&shard->dequeue_retries, memory_order_relaxed);
+    }
+#endif
+    out->size = queue_size_approx(queue);
+    return true;
+}
+
+#ifdef QUEUE_TRACE
+// Add one queue's histogram shards to a trace snapshot
+static void trace_sum(Queue* queue, QueueTrace* out) {
+    for (size_t i = 0; i < QUEUE_STAT_SHARDS; i++) {
+        QueueStatShard* shard = &queue->stats[i];
+        for (size_t b = 0; b < QUEUE_TRACE_BUCKETS; b++) {
+            out->residency[b] += atomic_load_explicit(&shard->residency[b], memory_order_relaxed);
+            out->enqueue_retries[b] += atomic_load_explicit(&shard->enqueue_retry_ops[b], memory_order_relaxed);
+            out->dequeue_retries[b] += atomic_load_explicit(&shard->dequeue_retry_ops[b], memory_order_relaxed);
+        }
+    }
+}
+#endif
+
+// Take a snapshot of the queue's trace histograms
+// Returns false (with *out zeroed) unless built with QUEUE_TRACE; like
+// queue_get_stats, shards are summed without stopping other threads
+bool queue_get_trace(Queue* queue, QueueTrace* out) {
+    if (queue == NULL || out == NULL) {
+        return false;
+    }
+    
+    memset(out, 0, sizeof(QueueTrace));
+#ifdef QUEUE_TRACE
+    trace_sum(queue, out);
+    if (queue->mode == QUEUE_MODE_PRIORITY) {
+        // Retries are charged to the priority queue, residency to its levels
+        for (size_t i = 0; i < QUEUE_PRIORITY_LEVELS; i++) {
+            trace_sum(queue->levels[i], out);
+        }
+    }
+    
+    // Calibrate ticks against the clock over the queue's lifetime so far
+    uint64_t ticks = trace_ticks() - queue->trace_origin_ticks;
+    uint64_t ns = eventcount_now_ns() - queue->trace_origin_ns;
+    out->ticks_per_ns = ns > 0 ? (double)ticks / (double)ns : 1.0;
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef QUEUE_TRACE
+// Print the non-empty buckets of a histogram
+static void print_histogram(const char* name, const uint64_t* buckets) {
+    printf("  %s:", name);
+    for (size_t b = 0; b < QUEUE_TRACE_BUCKETS; b++) {
+        if (buckets[b] > 0) {
+            printf(" [%llu]=%llu", b == 0 ? 0ULL : 1ULL << (b - 1), (unsigned long long)buckets[b]);
+        }
+    }
+    printf("\n");
+}
+#endif
+
+// Print queue statistics (counters and size)
+void queue_print_stats(Queue* queue) {
+    if (queue == NULL) {
+        printf("Queue is NULL\n");
+        return;
+    }
+    
+    QueueStats stats;
+    queue_get_stats(queue, &stats);
+    
+    static const char* mode_names[] = { "MPMC", "MPSC", "SPSC", "SEGMENT", "PRIORITY" };
+    
+    printf("Queue Statistics:\n");
+    printf("  Mode: %s\n", mode_names[queue->mode]);
+    printf("  Size: %zu\n", stats.size);
+    if (queue->mode == QUEUE_MODE_PRIORITY) {
+        printf("  Level Sizes: [");
+        for (size_t i = 0; i < QUEUE_PRIORITY_LEVELS; i++) {
+            printf("%s%zu", i > 0 ? ", " : "", queue_size(queue->levels[i]));
+        }
+        printf("]\n");
+    }
+#ifdef QUEUE_NO_STATS
+    printf("  Counters: disabled (built with QUEUE_NO_STATS)\n");
+#else
+    printf("  Enqueue Counter: %llu\n", (unsigned long long)stats.enqueued);
+    printf("  Dequeue Counter: %llu\n", (unsigned long long)stats.dequeued);
+    printf("  Enqueue Retries: %llu\n", (unsigned long long)stats.enqueue_retries);
+    printf("  Dequeue Retries: %llu\n", (unsigned long long)stats.dequeue_retries);
+    printf("  Net Operations: %lld\n", (long long)(stats.enqueued - stats.dequeued));
+#endif
+#ifdef QUEUE_TRACE
+    QueueTrace trace;
+    queue_get_trace(queue, &trace);
+    printf("  Ticks per ns: %.3f\n", trace.ticks_per_ns);
+    print_histogram("Residency (ticks)", trace.residency);
+    print_histogram("Enqueue Retries", trace.enqueue_retries);
+    print_histogram("Dequeue Retries", trace.dequeue_retries);
+#endif
+}
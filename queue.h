@@ -1,52 +1,258 @@
-#ifndef QUEUE_H
-#define QUEUE_H
-
-#include <stdatomic.h>
-#include <stdbool.h>
-#include <stddef.h>
-#include <stdint.h>
-#include <assert.h>
-
-// Structure to hold pointer with ABA prevention version counter
-typedef struct PointerWithABA {
-    struct Node* ptr;     // The actual pointer
-    unsigned int aba;     // ABA version counter (incremented on each pointer change)
-} PointerWithABA;
-
-// Compile-time check to ensure PointerWithABA is lock-free
-// This structure should fit in 16 bytes on 64-bit systems (8-byte pointer + 4-byte int + padding)
-// If atomic operations on this struct are not lock-free, the implementation may need adjustment
-static_assert(sizeof(PointerWithABA) <= 16, "PointerWithABA structure is too large for efficient atomic operations");
-
-// Node structure for doubly linked list
-// Note: On platforms without 16-byte atomic support (like Cygwin), we fall back
-// to using plain atomic pointers without ABA protection
-typedef struct Node {
-    void* data;           // Pointer to the data object
-    size_t length;        // Length of the data object in bytes
-    _Atomic(struct Node*) prev;  // Previous node pointer (ABA counter removed for Cygwin compatibility)
-    _Atomic(struct Node*) next;  // Next node pointer (ABA counter removed for Cygwin compatibility)
-} Node;
-
-// Queue structure
-typedef struct Queue {
-    Node* head;  // Sentinel head node (stable, doesn't change)
-    Node* tail;  // Sentinel tail node (stable, doesn't change)
-    atomic_size_t size;
-    atomic_uint enqueue_counter;  // Counter for successful enqueue operations (unsigned int)
-    atomic_uint dequeue_counter;  // Counter for successful dequeue operations (unsigned int)
-    atomic_uint enqueue_retries;  // Counter for enqueue retry attempts (CAS failures)
-    atomic_uint dequeue_retries;  // Counter for dequeue retry attempts (CAS failures)
-} Queue;
-
-// Function declarations
-Queue* queue_init(void);
-void queue_destroy(Queue* queue);
-bool queue_enqueue(Queue* queue, const void* data, size_t length);
-bool queue_dequeue(Queue* queue, void** data, size_t* length);
-bool queue_is_empty(Queue* queue);
-size_t queue_size(Queue* queue);
-void queue_print(Queue* queue, void (*print_func)(const void* data, size_t length));
-void queue_print_stats(Queue* queue);
-
-#endif // QUEUE_H
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <assert.h>
+#include "backoff.h"
+#include "eventcount.h"
+#include "queue_mem.h"
+#include "tagged.h"
+#include "trace.h"
+
+// Size of a node in bytes; headers plus inline payload fill exactly one cache line
+#ifndef QUEUE_NODE_SIZE
+#define QUEUE_NODE_SIZE QUEUE_CACHELINE
+#endif
+
+// Build with -DQUEUE_SINGLY_LINKED to drop the prev back-links: nothing in
+// the API walks backwards, and without them an enqueue or dequeue stores to
+// one cache line fewer (and inline payloads gain a pointer's worth of room)
+#ifdef QUEUE_SINGLY_LINKED
+#define QUEUE_NODE_LINKS 1
+#else
+#define QUEUE_NODE_LINKS 2
+#endif
+
+#if defined(QUEUE_TRACE) && defined(QUEUE_NO_STATS)
+#error "QUEUE_TRACE keeps its histograms in the statistics shards; it cannot be combined with QUEUE_NO_STATS"
+#endif
+
+// Bytes of the enqueue timestamp QUEUE_TRACE adds to every node
+#ifdef QUEUE_TRACE
+#define QUEUE_NODE_TRACE_BYTES sizeof(uint64_t)
+#else
+#define QUEUE_NODE_TRACE_BYTES 0
+#endif
+
+// Bytes taken by the node's link, length and timestamp fields
+#define QUEUE_NODE_HEADER (QUEUE_NODE_LINKS * sizeof(void*) + 2 * sizeof(uint32_t) + QUEUE_NODE_TRACE_BYTES)
+
+// Payloads up to this many bytes are stored inside the node instead of in a
+// separate allocation (override with -DQUEUE_INLINE_MAX=n, 0 disables)
+#ifndef QUEUE_INLINE_MAX
+#define QUEUE_INLINE_MAX (QUEUE_NODE_SIZE - QUEUE_NODE_HEADER)
+#endif
+
+// Node flags
+#define NODE_INLINE 0x1u  // Payload lives in payload.bytes
+#define NODE_OWNED  0x2u  // payload.data was handed over by queue_enqueue_owned
+#define NODE_ARENA  0x4u  // payload.data points into the queue's payload arena
+
+// Bits of flags naming the node pool a node belongs to (set by the pool, kept by the queue)
+#define NODE_POOL_SHIFT 8
+#define NODE_POOL_MASK  0xff00u
+
+// Node structure for doubly linked list (singly linked with QUEUE_SINGLY_LINKED)
+// Links are plain atomic pointers; ABA on the head/tail CAS is prevented by
+// epoch-based reclamation (see reclaim.h): a node is never freed or reused
+// while any thread that could still hold a reference to it is active
+// Nodes are cache-line aligned so two nodes never share a line
+typedef struct Node {
+    _Alignas(QUEUE_CACHELINE) _Atomic(struct Node*) next;  // Next node pointer (NULL for the last node)
+#ifndef QUEUE_SINGLY_LINKED
+    _Atomic(struct Node*) prev;  // Previous node pointer (NULL for the dummy node)
+#endif
+    uint32_t length;      // Length of the data object in bytes
+    uint32_t flags;       // NODE_* flags
+#ifdef QUEUE_TRACE
+    uint64_t enqueue_ticks;  // trace_ticks() when the node was created for an enqueue
+#endif
+    union {
+        void* data;       // Pointer to the data object (heap payloads)
+        unsigned char bytes[QUEUE_INLINE_MAX > sizeof(void*) ? QUEUE_INLINE_MAX : sizeof(void*)];
+    } payload;
+} Node;
+
+// Producer/consumer cardinality a queue is specialised for
+typedef enum QueueMode {
+    QUEUE_MODE_MPMC = 0,  // Any number of producers and consumers (Michael-Scott, CAS)
+    QUEUE_MODE_MPSC = 1,  // Any number of producers, one consumer thread (exchange, no CAS)
+    QUEUE_MODE_SPSC = 2,  // One producer thread, one consumer thread (wait-free, no CAS)
+    QUEUE_MODE_SEGMENT = 3,  // Any number of producers and consumers (fetch-and-add on array segments)
+    QUEUE_MODE_PRIORITY = 4,  // MPMC with QUEUE_PRIORITY_LEVELS levels; dequeue drains the highest first
+} QueueMode;
+
+// Cells per segment in QUEUE_MODE_SEGMENT
+#ifndef QUEUE_SEGMENT_SIZE
+#define QUEUE_SEGMENT_SIZE 1024
+#endif
+
+// Array segment of a QUEUE_MODE_SEGMENT queue (defined in queue.c)
+struct QueueSegment;
+
+// Overflow tier set up by queue_set_spill (defined in queue.c)
+struct QueueSpill;
+
+// Payload arena set up by queue_set_arena (see arena.h)
+struct PayloadArena;
+
+// Priority levels of a QUEUE_MODE_PRIORITY queue (at most 32)
+// Level 0 is the most urgent; enqueues that name no level use the last one
+#ifndef QUEUE_PRIORITY_LEVELS
+#define QUEUE_PRIORITY_LEVELS 4
+#endif
+
+static_assert(QUEUE_PRIORITY_LEVELS >= 1 && QUEUE_PRIORITY_LEVELS <= 32,
+              "QUEUE_PRIORITY_LEVELS must fit the 32-bit level mask");
+
+#define QUEUE_PRIORITY_HIGHEST 0
+#define QUEUE_PRIORITY_LOWEST (QUEUE_PRIORITY_LEVELS - 1)
+
+// Statistics
+//
+// Counters are split into shards, each on its own cache line; a thread always
+// updates the same shard, so counting an operation does not contend with
+// other threads the way a single shared counter would. queue_get_stats()
+// adds the shards up. Build with -DQUEUE_NO_STATS to compile counting out.
+
+// Number of counter shards per queue
+#ifndef QUEUE_STAT_SHARDS
+#define QUEUE_STAT_SHARDS 16
+#endif
+
+// One shard of a queue's operation counters
+typedef struct QueueStatShard {
+    _Alignas(QUEUE_CACHELINE) atomic_uint_fast64_t enqueued;  // Elements enqueued
+    atomic_uint_fast64_t dequeued;         // Elements dequeued
+    atomic_uint_fast64_t enqueue_retries;  // Enqueue retry attempts (CAS failures)
+    atomic_uint_fast64_t dequeue_retries;  // Dequeue retry attempts (CAS failures)
+#ifdef QUEUE_TRACE
+    atomic_uint_fast64_t residency[QUEUE_TRACE_BUCKETS];        // Dequeued elements by ticks spent queued
+    atomic_uint_fast64_t enqueue_retry_ops[QUEUE_TRACE_BUCKETS];  // Enqueue calls by CAS retries
+    atomic_uint_fast64_t dequeue_retry_ops[QUEUE_TRACE_BUCKETS];  // Dequeue calls by CAS retries
+#endif
+} QueueStatShard;
+
+// Snapshot of a queue's statistics (counters are zero with QUEUE_NO_STATS)
+typedef struct QueueStats {
+    uint64_t enqueued;         // Successful enqueues (elements)
+    uint64_t dequeued;         // Successful dequeues (elements)
+    uint64_t enqueue_retries;  // Enqueue retry attempts
+    uint64_t dequeue_retries;  // Dequeue retry attempts
+    uint64_t steals;           // Elements taken from a non-home lane (ShardedQueue only)
+    size_t size;               // Elements in the queue
+} QueueStats;
+
+// Close state of a queue (see queue_close)
+typedef enum QueueCloseState {
+    QUEUE_OPEN = 0,       // Enqueues are accepted
+    QUEUE_CLOSING = 1,    // New enqueues fail; ones already in flight may still land
+    QUEUE_CLOSED = 2,     // No enqueue will ever land again
+} QueueCloseState;
+
+// Snapshot of a queue's trace histograms (see trace.h for the buckets)
+// All zero unless built with QUEUE_TRACE
+typedef struct QueueTrace {
+    double ticks_per_ns;                         // Timestamp ticks per nanosecond
+    uint64_t residency[QUEUE_TRACE_BUCKETS];     // Dequeued elements by ticks spent in the queue
+    uint64_t enqueue_retries[QUEUE_TRACE_BUCKETS];  // Enqueue calls by CAS retries needed
+    uint64_t dequeue_retries[QUEUE_TRACE_BUCKETS];  // Dequeue calls by CAS retries needed
+} QueueTrace;
+
+// Queue structure (Michael-Scott style list with a dummy node)
+// Fields written by consumers and fields written by producers each get their
+// own cache line, so an enqueue never invalidates the line a concurrent
+// dequeue is spinning on (and vice versa). The size is not a shared counter:
+// each side advances its own ticket, and queue_size() subtracts the two.
+typedef struct Queue {
+    // Read-only after init
+    void (*destructor)(void* data, size_t length);  // Releases owned payloads left at destroy (NULL: free())
+    QueueMode mode;       // Enqueue/dequeue algorithm, fixed at init
+    BackoffConfig backoff;  // How MPMC retry loops wait after a failed CAS
+    int numa_node;        // NUMA node the queue and its nodes are placed on (-1: unbound)
+    struct Queue* levels[QUEUE_PRIORITY_LEVELS];  // QUEUE_MODE_PRIORITY: one MPMC queue per level
+    struct QueueSpill* spill;  // Overflow tier (NULL: none)
+    struct PayloadArena* arena;  // Where heap payload copies are carved from (NULL: malloc)
+    atomic_uint closed;   // QueueCloseState; written only by queue_close
+#ifdef QUEUE_TRACE
+    uint64_t trace_origin_ticks;  // trace_ticks() at init, to calibrate ticks_per_ns
+    uint64_t trace_origin_ns;     // eventcount_now_ns() at init
+#endif
+    
+    // Consumer side
+    _Alignas(QUEUE_CACHELINE) _Atomic(Node*) head;  // Dummy node; head->next is the first element
+    _Atomic(struct QueueSegment*) head_segment;  // QUEUE_MODE_SEGMENT: oldest segment
+    atomic_size_t dequeue_ticket;  // Elements dequeued so far (only ever grows)
+    atomic_uint inspectors;  // queue_dequeue_if/queue_peek calls reading a heap payload in place
+    
+    // Producer side
+    _Alignas(QUEUE_CACHELINE) _Atomic(Node*) tail;  // Last node (may briefly lag one node behind)
+    _Atomic(struct QueueSegment*) tail_segment;  // QUEUE_MODE_SEGMENT: newest segment (may lag)
+    atomic_size_t enqueue_ticket;  // Elements enqueued so far (only ever grows)
+    
+    // Written by both sides
+    _Alignas(QUEUE_CACHELINE) atomic_uint level_mask;  // QUEUE_MODE_PRIORITY: bit i set while level i may be non-empty
+    
+    // Sleeping consumers (written only when a consumer parks or is woken,
+    // so producers normally just read it)
+    _Alignas(QUEUE_CACHELINE) EventCount not_empty;
+
+#ifndef QUEUE_NO_STATS
+    QueueStatShard stats[QUEUE_STAT_SHARDS];  // Operation counters, summed by queue_get_stats
+#endif
+} Queue;
+
+// Spin attempts a waiting dequeue makes before it parks
+#ifndef QUEUE_WAIT_SPINS
+#define QUEUE_WAIT_SPINS 100
+#endif
+
+// Timeout for queue_dequeue_wait that never expires
+#define QUEUE_WAIT_FOREVER EVENTCOUNT_FOREVER
+
+// Outcome of queue_dequeue_wait
+typedef enum QueueWaitStatus {
+    QUEUE_WAIT_TIMEOUT = 0,  // Nothing arrived in time (also returned for invalid arguments)
+    QUEUE_WAIT_OK = 1,       // An element was dequeued
+    QUEUE_WAIT_CLOSED = 2,   // The queue is closed and drained: nothing will ever arrive
+} QueueWaitStatus;
+
+// Function declarations
+Queue* queue_init(void);
+Queue* queue_init_mode(QueueMode mode);
+Queue* queue_init_numa(QueueMode mode, int numa_node);
+Queue* queue_init_with_pool(size_t capacity);
+void queue_destroy(Queue* queue);
+bool queue_close(Queue* queue);
+bool queue_is_closed(Queue* queue);
+bool queue_enqueue(Queue* queue, const void* data, size_t length);
+bool queue_enqueue_priority(Queue* queue, const void* data, size_t length, unsigned int priority);
+bool queue_enqueue_owned(Queue* queue, void* data, size_t length);
+bool queue_enqueue_batch(Queue* queue, const void** items, const size_t* lengths, size_t n);
+void queue_set_destructor(Queue* queue, void (*destructor)(void* data, size_t length));
+bool queue_set_backoff(Queue* queue, const BackoffConfig* config);
+bool queue_set_spill(Queue* queue, const char* directory, size_t high_water, size_t low_water);
+bool queue_set_arena(Queue* queue, size_t chunk_bytes);
+bool queue_reset_arena(Queue* queue);
+bool queue_dequeue(Queue* queue, void** data, size_t* length);
+QueueWaitStatus queue_dequeue_wait(Queue* queue, void** data, size_t* length, uint64_t timeout_ns);
+bool queue_dequeue_into(Queue* queue, void* buffer, size_t capacity, size_t* length);
+bool queue_dequeue_view(Queue* queue, const void** data, size_t* length);
+bool queue_dequeue_if(Queue* queue, bool (*pred)(const void* data, size_t length, void* ctx), void* ctx,
+                      void** data, size_t* length);
+bool queue_peek(Queue* queue, void* buffer, size_t capacity, size_t* length);
+size_t queue_dequeue_batch(Queue* queue, void** out, size_t* lens, size_t max);
+size_t queue_dequeue_batch_owned(Queue* queue, void** out, size_t* lens, bool* owned, size_t max);
+bool queue_is_empty(Queue* queue);
+size_t queue_size(Queue* queue);
+size_t queue_size_approx(Queue* queue);
+size_t queue_size_exact(Queue* queue);
+void queue_print(Queue* queue, void (*print_func)(const void* data, size_t length));
+bool queue_get_stats(Queue* queue, QueueStats* out);
+bool queue_get_trace(Queue* queue, QueueTrace* out);
+void queue_print_stats(Queue* queue);
+
+#endif // QUEUE_H
@@ -0,0 +1,276 @@
+#define _GNU_SOURCE
+#include "queue_mem.h"
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+// Memory policy from <linux/mempolicy.h>: allocate on the given node if it has free pages
+#define MEMPOLICY_PREFERRED 1
+
+// madvise advice from Linux 5.14: fault a range in writable in one call
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+#endif
+
+// Page size assumed where the system cannot be asked (also the smallest
+// page size in use, so touching every FALLBACK_PAGE_SIZE bytes reaches every page)
+#define FALLBACK_PAGE_SIZE 4096
+
+static atomic_int numa_node_count = 0;  // Cached result of queue_mem_numa_nodes (0: not read yet)
+
+// Allocate size bytes aligned to alignment
+void* queue_mem_alloc_aligned(size_t alignment, size_t size) {
+    if (alignment < sizeof(void*)) {
+        alignment = sizeof(void*);
+    }
+#ifdef _WIN32
+    return _aligned_malloc(size, alignment);
+#else
+    void* ptr = NULL;
+    if (posix_memalign(&ptr, alignment, size) != 0) {
+        return NULL;
+    }
+    return ptr;
+#endif
+}
+
+// Free aligned memory
+void queue_mem_free_aligned(void* ptr) {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    free(ptr);
+#endif
+}
+
+// Ask the system how many NUMA nodes there are
+static int read_numa_nodes(void) {
+#ifdef _WIN32
+    ULONG highest = 0;
+    if (GetNumaHighestNodeNumber(&highest)) {
+        return (int)highest + 1;
+    }
+#elif defined(__linux__)
+    // The list of possible nodes looks like "0" or "0-1" or "0,2-3"
+    FILE* file = fopen("/sys/devices/system/node/possible", "r");
+    if (file != NULL) {
+        int highest = -1;
+        int value;
+        while (fscanf(file, "%d", &value) == 1) {
+            if (value > highest) {
+                highest = value;
+            }
+            if (fgetc(file) == EOF) {
+                break;
+            }
+        }
+        fclose(file);
+        if (highest >= 0) {
+            return highest + 1;
+        }
+    }
+#endif
+    return 1;
+}
+
+// Number of NUMA nodes in the system
+int queue_mem_numa_nodes(void) {
+    int count = atomic_load_explicit(&numa_node_count, memory_order_relaxed);
+    if (count == 0) {
+        count = read_numa_nodes();
+        atomic_store_explicit(&numa_node_count, count, memory_order_relaxed);
+    }
+    return count;
+}
+
+// NUMA node the calling thread is running on
+int queue_mem_current_node(void) {
+#ifdef _WIN32
+    PROCESSOR_NUMBER processor;
+    USHORT node;
+    GetCurrentProcessorNumberEx(&processor);
+    if (GetNumaProcessorNodeEx(&processor, &node)) {
+        return (int)node;
+    }
+#elif defined(__linux__)
+    unsigned int cpu;
+    unsigned int node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+        return (int)node;
+    }
+#endif
+    return 0;
+}
+
+#ifdef __linux__
+// Prefer numa_node for the pages of a fresh mapping
+// No page has been touched yet, so the policy decides where every page is
+// faulted in. Kernels without NUMA support reject the call; the pages then
+// simply land wherever the first write happens.
+static void bind_to_node(void* ptr, size_t size, int numa_node) {
+    if ((size_t)numa_node < 8 * sizeof(unsigned long) - 1) {
+        unsigned long mask = 1UL << numa_node;
+        (void)syscall(SYS_mbind, ptr, size, MEMPOLICY_PREFERRED, &mask, 8 * sizeof(mask), 0);
+    }
+}
+#endif
+
+// Allocate page-aligned memory on a NUMA node
+void* queue_mem_alloc_on_node(size_t size, int numa_node) {
+    if (size == 0 || numa_node < 0) {
+        return NULL;
+    }
+#ifdef _WIN32
+    return VirtualAllocExNuma(GetCurrentProcess(), NULL, size, MEM_RESERVE | MEM_COMMIT,
+                              PAGE_READWRITE, (DWORD)numa_node);
+#elif defined(__linux__)
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return NULL;
+    }
+    bind_to_node(ptr, size, numa_node);
+    return ptr;
+#else
+    return queue_mem_alloc_aligned(FALLBACK_PAGE_SIZE, size);
+#endif
+}
+
+// Free memory placed with queue_mem_alloc_on_node
+void queue_mem_free_on_node(void* ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#elif defined(__linux__)
+    munmap(ptr, size);
+#else
+    (void)size;
+    queue_mem_free_aligned(ptr);
+#endif
+}
+
+// Round a size up to whole huge pages
+size_t queue_mem_huge_size(size_t size) {
+    if (size > SIZE_MAX - (QUEUE_HUGE_PAGE_SIZE - 1)) {
+        return 0;
+    }
+    return (size + QUEUE_HUGE_PAGE_SIZE - 1) & ~(size_t)(QUEUE_HUGE_PAGE_SIZE - 1);
+}
+
+// Allocate prefaulted memory backed by huge pages where possible
+void* queue_mem_alloc_huge(size_t size, int numa_node) {
+    size = queue_mem_huge_size(size);
+    if (size == 0 || numa_node < -1) {
+        return NULL;
+    }
+#ifdef _WIN32
+    // Large pages are committed and locked up front, but need the privilege
+    SIZE_T large = GetLargePageMinimum();
+    void* ptr = NULL;
+    DWORD type = MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES;
+    if (large != 0 && size % large == 0) {
+        ptr = (numa_node >= 0)
+            ? VirtualAllocExNuma(GetCurrentProcess(), NULL, size, type, PAGE_READWRITE, (DWORD)numa_node)
+            : VirtualAlloc(NULL, size, type, PAGE_READWRITE);
+    }
+    if (ptr == NULL) {
+        type = MEM_RESERVE | MEM_COMMIT;
+        ptr = (numa_node >= 0)
+            ? VirtualAllocExNuma(GetCurrentProcess(), NULL, size, type, PAGE_READWRITE, (DWORD)numa_node)
+            : VirtualAlloc(NULL, size, type, PAGE_READWRITE);
+        if (ptr == NULL) {
+            return NULL;
+        }
+    }
+#elif defined(__linux__)
+    void* ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    // Fails unless the administrator reserved huge pages
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (ptr == MAP_FAILED) {
+        // Map one huge page more and trim the ends, so the range is aligned to
+        // huge pages and transparent huge pages can back all of it
+        size_t span = size + QUEUE_HUGE_PAGE_SIZE;
+        char* base = (char*)mmap(NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            return NULL;
+        }
+        char* aligned = (char*)(((uintptr_t)base + QUEUE_HUGE_PAGE_SIZE - 1) & ~(uintptr_t)(QUEUE_HUGE_PAGE_SIZE - 1));
+        if (aligned > base) {
+            munmap(base, (size_t)(aligned - base));
+        }
+        if (base + span > aligned + size) {
+            munmap(aligned + size, (size_t)(base + span - (aligned + size)));
+        }
+        ptr = aligned;
+#ifdef MADV_HUGEPAGE
+        (void)madvise(ptr, size, MADV_HUGEPAGE);  // Advisory: THP may be disabled
+#endif
+    }
+    if (numa_node >= 0) {
+        bind_to_node(ptr, size, numa_node);
+    }
+#else
+    (void)numa_node;
+    void* ptr = queue_mem_alloc_aligned(QUEUE_HUGE_PAGE_SIZE, size);
+    if (ptr == NULL) {
+        return NULL;
+    }
+#endif
+    queue_mem_prefault(ptr, size);
+    return ptr;
+}
+
+// Free memory returned by queue_mem_alloc_huge
+void queue_mem_free_huge(void* ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#elif defined(__linux__)
+    munmap(ptr, queue_mem_huge_size(size));
+#else
+    (void)size;
+    queue_mem_free_aligned(ptr);
+#endif
+}
+
+// Fault in every page of a range
+void queue_mem_prefault(void* ptr, size_t size) {
+    if (ptr == NULL || size == 0) {
+        return;
+    }
+#ifdef __linux__
+    // One call for the whole range where the kernel supports it
+    long page = sysconf(_SC_PAGESIZE);
+    if (page > 0) {
+        uintptr_t start = (uintptr_t)ptr & ~(uintptr_t)(page - 1);
+        size_t length = (size_t)((uintptr_t)ptr + size - start);
+        if (madvise((void*)start, length, MADV_POPULATE_WRITE) == 0) {
+            return;
+        }
+    }
+#endif
+    // Otherwise write every page back to itself
+    volatile char* bytes = (volatile char*)ptr;
+    for (size_t i = 0; i < size; i += FALLBACK_PAGE_SIZE) {
+        bytes[i] = bytes[i];
+    }
+    bytes[size - 1] = bytes[size - 1];
+}
@@ -0,0 +1,74 @@
+#ifndef QUEUE_MEM_H
+#define QUEUE_MEM_H
+
+#include <stddef.h>
+
+// Cache line size used to keep independently written fields apart
+// (override with -DQUEUE_CACHELINE=128 on machines with 128-byte lines)
+#ifndef QUEUE_CACHELINE
+#define QUEUE_CACHELINE 64
+#endif
+
+// Allocate size bytes aligned to alignment (a power of two)
+void* queue_mem_alloc_aligned(size_t alignment, size_t size);
+
+// Free memory returned by queue_mem_alloc_aligned
+void queue_mem_free_aligned(void* ptr);
+
+// NUMA placement
+//
+// Memory from queue_mem_alloc_on_node is mapped directly from the system and
+// its pages are placed on one NUMA node (preferred, so the kernel can still
+// fall back to another node when that one is full). Linux sets the policy
+// with the mbind system call, so there is no libnuma dependency; Windows uses
+// VirtualAllocExNuma. Elsewhere the calls fall back to ordinary allocations.
+
+// NUMA nodes a queue or node pool can be bound to (nodes 0 .. max - 1)
+#ifndef QUEUE_NUMA_MAX_NODES
+#define QUEUE_NUMA_MAX_NODES 8
+#endif
+
+// Number of NUMA nodes in the system (1 if it cannot be determined)
+int queue_mem_numa_nodes(void);
+
+// NUMA node of the CPU the calling thread is running on (0 if unknown)
+int queue_mem_current_node(void);
+
+// Allocate size bytes of page-aligned memory placed on NUMA node numa_node
+void* queue_mem_alloc_on_node(size_t size, int numa_node);
+
+// Free memory returned by queue_mem_alloc_on_node (size as passed to it)
+void queue_mem_free_on_node(void* ptr, size_t size);
+
+// Huge pages
+//
+// Memory from queue_mem_alloc_huge is mapped in QUEUE_HUGE_PAGE_SIZE units,
+// so a large structure costs one TLB entry per huge page instead of one per
+// base page. Linux first takes pages from the reserved huge page pool
+// (MAP_HUGETLB, sized by /proc/sys/vm/nr_hugepages) and otherwise maps
+// huge-page-aligned memory and asks for transparent huge pages
+// (MADV_HUGEPAGE). Windows uses large pages when the process holds
+// SeLockMemoryPrivilege. The memory is prefaulted before it is returned, so
+// the first writes to it never take a page fault. Where none of this is
+// available the memory is ordinary, but still aligned and prefaulted.
+
+// Huge page size (override with -DQUEUE_HUGE_PAGE_SIZE=... where it differs)
+#ifndef QUEUE_HUGE_PAGE_SIZE
+#define QUEUE_HUGE_PAGE_SIZE (2u * 1024 * 1024)
+#endif
+
+// Round size up to whole huge pages (0 on overflow)
+size_t queue_mem_huge_size(size_t size);
+
+// Allocate queue_mem_huge_size(size) bytes of prefaulted memory backed by huge
+// pages where possible, placed on numa_node (-1: unbound)
+void* queue_mem_alloc_huge(size_t size, int numa_node);
+
+// Free memory returned by queue_mem_alloc_huge (size as passed to it)
+void queue_mem_free_huge(void* ptr, size_t size);
+
+// Fault in every page of [ptr, ptr + size) so later accesses do not trap
+// Contents are kept; call it before the memory is shared with other threads
+void queue_mem_prefault(void* ptr, size_t size);
+
+#endif // QUEUE_MEM_H
@@ -0,0 +1,245 @@
+#include "reclaim.h"
+#include "queue_mem.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of retirements between collection attempts
+#define RECLAIM_BATCH 64
+
+// Initial capacity of a thread's retire list
+#define RECLAIM_INITIAL_CAPACITY 128
+
+// An object waiting for its grace period to expire
+typedef struct RetiredEntry {
+    void* ptr;            // Object to release
+    reclaim_fn release;   // How to release it
+    uint64_t epoch;       // Global epoch observed when the object was retired
+} RetiredEntry;
+
+// Per-thread reclamation state
+// Records are never freed; a record released by an exiting thread is reused
+// by the next thread that needs one (together with any objects still pending)
+// Each record starts on its own cache line: the owner writes state on every
+// enter/exit and must not invalidate a neighbouring thread's record
+typedef struct ThreadRecord {
+    _Alignas(QUEUE_CACHELINE) atomic_uint_fast64_t state;    // (epoch << 1) | 1 while inside a critical section, 0 otherwise
+    atomic_bool in_use;            // Record is owned by a live thread
+    struct ThreadRecord* next;     // Next record in the global registry
+    
+    // Owner-only fields
+    unsigned int nesting;          // Critical section nesting depth
+    bool collecting;               // Release callbacks are running
+    size_t next_collect;           // Retire count that triggers the next collection
+    RetiredEntry* retired;         // Retire list, ordered by epoch
+    size_t count;
+    size_t capacity;
+    RetiredEntry* scratch;         // Entries being released by the current collection
+    size_t scratch_capacity;
+} ThreadRecord;
+
+static atomic_uint_fast64_t global_epoch = 1;
+static _Atomic(ThreadRecord*) registry = NULL;
+
+static _Thread_local ThreadRecord* local_record = NULL;
+static pthread_key_t record_key;
+static pthread_once_t record_key_once = PTHREAD_ONCE_INIT;
+
+static void record_release(void* arg);
+
+static void record_key_create(void) {
+    pthread_key_create(&record_key, record_release);
+}
+
+// Claim a free record or register a new one for the calling thread
+static ThreadRecord* record_acquire(void) {
+    pthread_once(&record_key_once, record_key_create);
+    
+    ThreadRecord* rec = atomic_load_explicit(&registry, memory_order_acquire);
+    for (; rec != NULL; rec = rec->next) {
+        bool expected = false;
+        if (!atomic_load_explicit(&rec->in_use, memory_order_relaxed) &&
+            atomic_compare_exchange_strong_explicit(&rec->in_use, &expected, true,
+                                                    memory_order_acquire,
+                                                    memory_order_relaxed)) {
+            break;
+        }
+    }
+    
+    if (rec == NULL) {
+        rec = (ThreadRecord*)queue_mem_alloc_aligned(_Alignof(ThreadRecord), sizeof(ThreadRecord));
+        if (rec == NULL) {
+            abort();  // Cannot protect shared memory without a record
+        }
+        memset(rec, 0, sizeof(ThreadRecord));
+        atomic_init(&rec->state, 0);
+        atomic_init(&rec->in_use, true);
+        rec->next_collect = RECLAIM_BATCH;
+        
+        // Push onto the registry (records are only ever added, so no ABA)
+        ThreadRecord* head = atomic_load_explicit(&registry, memory_order_relaxed);
+        do {
+            rec->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&registry, &head, rec,
+                                                        memory_order_release,
+                                                        memory_order_relaxed));
+    }
+    
+    pthread_setspecific(record_key, rec);
+    local_record = rec;
+    return rec;
+}
+
+static inline ThreadRecord* record_get(void) {
+    ThreadRecord* rec = local_record;
+    if (rec != NULL) {
+        return rec;
+    }
+    return record_acquire();
+}
+
+// Advance the global epoch if every active thread has observed the current one
+static void epoch_try_advance(void) {
+    uint64_t epoch = atomic_load(&global_epoch);
+    atomic_thread_fence(memory_order_seq_cst);
+    
+    for (ThreadRecord* rec = atomic_load_explicit(&registry, memory_order_acquire);
+         rec != NULL; rec = rec->next) {
+        uint64_t state = atomic_load(&rec->state);
+        if ((state & 1) != 0 && (state >> 1) != epoch) {
+            return;  // A thread is still pinned to an older epoch
+        }
+    }
+    
+    atomic_compare_exchange_strong(&global_epoch, &epoch, epoch + 1);
+}
+
+// Release every retired object whose grace period has expired
+static void record_collect(ThreadRecord* rec) {
+    if (rec->collecting) {
+        return;  // Called from a release callback; the outer collection continues
+    }
+    
+    epoch_try_advance();
+    uint64_t epoch = atomic_load(&global_epoch);
+    
+    size_t ready = 0;
+    while (ready < rec->count && rec->retired[ready].epoch + 2 <= epoch) {
+        ready++;
+    }
+    rec->next_collect = rec->count - ready + RECLAIM_BATCH;
+    if (ready == 0) {
+        return;
+    }
+    
+    // Move the ready prefix aside so callbacks may retire more objects safely
+    if (ready > rec->scratch_capacity) {
+        RetiredEntry* scratch = (RetiredEntry*)realloc(rec->scratch, ready * sizeof(RetiredEntry));
+        if (scratch == NULL) {
+            return;  // Try again on the next collection
+        }
+        rec->scratch = scratch;
+        rec->scratch_capacity = ready;
+    }
+    memcpy(rec->scratch, rec->retired, ready * sizeof(RetiredEntry));
+    rec->count -= ready;
+    memmove(rec->retired, rec->retired + ready, rec->count * sizeof(RetiredEntry));
+    
+    rec->collecting = true;
+    for (size_t i = 0; i < ready; i++) {
+        rec->scratch[i].release(rec->scratch[i].ptr);
+    }
+    rec->collecting = false;
+}
+
+// Thread exit: release what we can and hand the record back to the registry
+static void record_release(void* arg) {
+    ThreadRecord* rec = (ThreadRecord*)arg;
+    rec->nesting = 0;
+    atomic_store_explicit(&rec->state, 0, memory_order_release);
+    
+    // A few attempts usually drain the list; leftovers pass to the next owner
+    for (int i = 0; i < 3 && rec->count > 0; i++) {
+        record_collect(rec);
+    }
+    
+    local_record = NULL;
+    atomic_store_explicit(&rec->in_use, false, memory_order_release);
+}
+
+// Begin a critical section
+void reclaim_enter(void) {
+    ThreadRecord* rec = record_get();
+    if (rec->nesting++ > 0) {
+        return;
+    }
+    
+    // Announce the epoch, then confirm it is still current so that any later
+    // advance is guaranteed to see this thread as active
+    uint64_t epoch = atomic_load(&global_epoch);
+    while (true) {
+        atomic_store_explicit(&rec->state, (epoch << 1) | 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        uint64_t current = atomic_load(&global_epoch);
+        if (current == epoch) {
+            break;
+        }
+        epoch = current;
+    }
+}
+
+// End a critical section
+void reclaim_exit(void) {
+    ThreadRecord* rec = local_record;
+    if (--rec->nesting == 0) {
+        atomic_store_explicit(&rec->state, 0, memory_order_release);
+    }
+}
+
+// Defer release of an unlinked object
+void reclaim_retire(void* ptr, reclaim_fn release) {
+    ThreadRecord* rec = record_get();
+    
+    if (rec->count == rec->capacity) {
+        size_t capacity = rec->capacity == 0 ? RECLAIM_INITIAL_CAPACITY : rec->capacity * 2;
+        RetiredEntry* retired = (RetiredEntry*)realloc(rec->retired, capacity * sizeof(RetiredEntry));
+        if (retired == NULL) {
+            abort();  // Releasing early would be a use-after-free; leaking silently hides the bug
+        }
+        rec->retired = retired;
+        rec->capacity = capacity;
+    }
+    
+    RetiredEntry* entry = &rec->retired[rec->count++];
+    entry->ptr = ptr;
+    entry->release = release;
+    entry->epoch = atomic_load(&global_epoch);
+    
+    if (rec->count >= rec->next_collect) {
+        record_collect(rec);
+    }
+}
+
+// Release whatever the calling thread can release now
+void reclaim_collect(void) {
+    record_collect(record_get());
+}
+
+// Wait for a grace period
+// Two epoch advances after the call, every thread that was inside a critical
+// section when it started has left it (each advance waits for all active
+// threads to observe the current epoch)
+void reclaim_synchronize(void) {
+    uint64_t target = atomic_load(&global_epoch) + 2;
+    while (true) {
+        epoch_try_advance();
+        if (atomic_load(&global_epoch) >= target) {
+            return;
+        }
+        sched_yield();
+    }
+}
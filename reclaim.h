@@ -0,0 +1,39 @@
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include <stddef.h>
+
+// Epoch-based memory reclamation (EBR)
+//
+// Lock-free structures cannot free an unlinked object immediately because a
+// concurrent thread may still be reading it. Instead, every access to shared
+// nodes happens inside a critical section (reclaim_enter/reclaim_exit) and
+// unlinked objects are handed to reclaim_retire(). Retired objects are kept on
+// a per-thread list and released in batches once the global epoch has advanced
+// twice past the epoch they were retired in, which guarantees that no thread
+// is still inside a critical section that could have observed them.
+//
+// The subsystem is process-wide and pluggable: any structure can retire its
+// own objects by supplying the callback that releases them.
+
+// Callback invoked once a retired object can no longer be referenced
+typedef void (*reclaim_fn)(void* ptr);
+
+// Begin a critical section (may be nested)
+void reclaim_enter(void);
+
+// End a critical section
+void reclaim_exit(void);
+
+// Defer release of an object that has been unlinked from a shared structure
+void reclaim_retire(void* ptr, reclaim_fn release);
+
+// Try to advance the epoch and release everything the calling thread retired
+// that is now safe to free
+void reclaim_collect(void);
+
+// Wait until every critical section that was active at the call has ended
+// (must not be called from inside a critical section)
+void reclaim_synchronize(void);
+
+#endif // RECLAIM_H
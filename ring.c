@@ -0,0 +1,201 @@
+#include "ring.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+// Initialize an empty ring whose slots come from huge pages or malloc
+static RingQueue* ring_create(size_t capacity_pow2, bool huge) {
+    if (capacity_pow2 < 2 || (capacity_pow2 & (capacity_pow2 - 1)) != 0 ||
+        capacity_pow2 > SIZE_MAX / sizeof(RingSlot)) {
+        return NULL;
+    }
+    
+    RingQueue* ring = (RingQueue*)queue_mem_alloc_aligned(_Alignof(RingQueue), sizeof(RingQueue));
+    if (ring == NULL) {
+        return NULL;
+    }
+    
+    size_t bytes = capacity_pow2 * sizeof(RingSlot);
+    ring->slot_bytes = huge ? bytes : 0;
+    ring->slots = huge ? (RingSlot*)queue_mem_alloc_huge(bytes, -1)
+                       : (RingSlot*)queue_mem_alloc_aligned(QUEUE_CACHELINE, bytes);
+    if (ring->slots == NULL) {
+        queue_mem_free_aligned(ring);
+        return NULL;
+    }
+    
+    // Slot i is initially free for position i
+    for (size_t i = 0; i < capacity_pow2; i++) {
+        atomic_init(&ring->slots[i].sequence, i);
+        ring->slots[i].data = NULL;
+        atomic_init(&ring->slots[i].length, 0);
+    }
+    
+    ring->mask = capacity_pow2 - 1;
+    ring->destructor = NULL;
+    atomic_init(&ring->enqueue_pos, 0);
+    atomic_init(&ring->dequeue_pos, 0);
+    
+    return ring;
+}
+
+// Initialize an empty ring with capacity_pow2 slots (a power of two, at least 2)
+RingQueue* ring_init(size_t capacity_pow2) {
+    return ring_create(capacity_pow2, false);
+}
+
+// Initialize an empty ring whose slots are mapped from huge pages and
+// prefaulted (see queue_mem.h), so no access to them takes a TLB miss or page
+// fault on first touch
+RingQueue* ring_init_huge(size_t capacity_pow2) {
+    return ring_create(capacity_pow2, true);
+}
+
+// Destroy ring, releasing any elements still in it
+// Must not be called while other threads are still using the ring
+void ring_destroy(RingQueue* ring) {
+    if (ring == NULL) {
+        return;
+    }
+    
+    void* data;
+    size_t length;
+    while (ring_try_dequeue(ring, &data, &length)) {
+        if (ring->destructor != NULL) {
+            ring->destructor(data, length);
+        } else {
+            free(data);
+        }
+    }
+    
+    if (ring->slot_bytes != 0) {
+        queue_mem_free_huge(ring->slots, ring->slot_bytes);
+    } else {
+        queue_mem_free_aligned(ring->slots);
+    }
+    queue_mem_free_aligned(ring);
+}
+
+// Register the function that releases elements left in the ring at destroy
+void ring_set_destructor(RingQueue* ring, void (*destructor)(void* data, size_t length)) {
+    if (ring != NULL) {
+        ring->destructor = destructor;
+    }
+}
+
+// Try to add an element (returns false if the ring is full)
+bool ring_try_enqueue(RingQueue* ring, void* data, size_t length) {
+    if (ring == NULL || (data == NULL && length > 0)) {
+        return false;
+    }
+    
+    size_t pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+    RingSlot* slot;
+    
+    while (true) {
+        slot = &ring->slots[pos & ring->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+        
+        if (diff == 0) {
+            // Slot is free for this position: claim it
+            if (atomic_compare_exchange_weak_explicit(&ring->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+            // CAS failed - pos now holds the current position, retry
+        } else if (diff < 0) {
+            // Slot still holds the element from one lap ago: ring is full
+            return false;
+        } else {
+            // Another producer claimed this position; catch up
+            pos = atomic_load_explicit(&ring->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    
+    // Fill the slot, then publish it to consumers
+    slot->data = data;
+    atomic_store_explicit(&slot->length, length, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+    return true;
+}
+
+// Try to remove an element (returns false if the ring is empty)
+bool ring_try_dequeue(RingQueue* ring, void** data, size_t* length) {
+    return ring_try_dequeue_fit(ring, SIZE_MAX, data, length);
+}
+
+// Try to remove an element no longer than max_length bytes
+// Returns false with *length 0 if the ring is empty; an oldest element that
+// is too long stays in the ring and *length reports its size
+bool ring_try_dequeue_fit(RingQueue* ring, size_t max_length, void** data, size_t* length) {
+    if (ring == NULL || data == NULL || length == NULL) {
+        return false;
+    }
+    *length = 0;
+    
+    size_t pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+    RingSlot* slot;
+    
+    while (true) {
+        slot = &ring->slots[pos & ring->mask];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1);
+        
+        if (diff == 0) {
+            // Slot is full for this position: claim it if the element fits.
+            // The length read is this element's as long as nobody has taken
+            // the position yet, which the claim (or the recheck) confirms
+            size_t held = atomic_load_explicit(&slot->length, memory_order_relaxed);
+            if (held > max_length) {
+                size_t current = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+                if (current == pos) {
+                    *length = held;
+                    return false;
+                }
+                pos = current;
+                continue;
+            }
+            if (atomic_compare_exchange_weak_explicit(&ring->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Producer has not filled this position yet: ring is empty
+            return false;
+        } else {
+            // Another consumer claimed this position; catch up
+            pos = atomic_load_explicit(&ring->dequeue_pos, memory_order_relaxed);
+        }
+    }
+    
+    // Take the element, then free the slot for the producer one lap ahead
+    *data = slot->data;
+    *length = atomic_load_explicit(&slot->length, memory_order_relaxed);
+    atomic_store_explicit(&slot->sequence, pos + ring->mask + 1, memory_order_release);
+    return true;
+}
+
+// Check if ring is empty
+bool ring_is_empty(RingQueue* ring) {
+    return ring_size(ring) == 0;
+}
+
+// Get the number of elements in the ring (approximate while it is in use)
+size_t ring_size(RingQueue* ring) {
+    if (ring == NULL) {
+        return 0;
+    }
+    size_t dequeued = atomic_load_explicit(&ring->dequeue_pos, memory_order_acquire);
+    size_t enqueued = atomic_load_explicit(&ring->enqueue_pos, memory_order_acquire);
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+// Get the number of slots
+size_t ring_capacity(RingQueue* ring) {
+    if (ring == NULL) {
+        return 0;
+    }
+    return ring->mask + 1;
+}
@@ -0,0 +1,50 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "queue_mem.h"
+
+// Bounded lock-free MPMC ring buffer (Vyukov-style per-slot sequence numbers)
+//
+// All slots are allocated once by ring_init; enqueue and dequeue never
+// allocate and never chase pointers. Each slot carries a sequence number that
+// tells producers and consumers whose turn it is, so the only contended
+// operation is one CAS on the enqueue or dequeue position per element.
+// A full ring rejects new elements instead of growing (natural backpressure).
+//
+// Elements are stored by reference: the ring keeps the caller's pointer and
+// length, and the consumer receives exactly that pointer back.
+
+// Ring slot
+typedef struct RingSlot {
+    atomic_size_t sequence;  // Slot is free for position p when sequence == p, full when p + 1
+    void* data;              // Element pointer
+    atomic_size_t length;    // Element length in bytes (read before the claim by ring_try_dequeue_fit)
+} RingSlot;
+
+// Ring structure
+// The read-only fields and each position sit on their own cache line
+typedef struct RingQueue {
+    RingSlot* slots;         // capacity slots
+    size_t mask;             // capacity - 1
+    void (*destructor)(void* data, size_t length);  // Releases elements left at destroy (NULL: free())
+    size_t slot_bytes;       // Size of the huge-page slot mapping (0: slots from queue_mem_alloc_aligned)
+    _Alignas(QUEUE_CACHELINE) atomic_size_t enqueue_pos;  // Next position to fill (producers only)
+    _Alignas(QUEUE_CACHELINE) atomic_size_t dequeue_pos;  // Next position to drain (consumers only)
+} RingQueue;
+
+// Function declarations
+RingQueue* ring_init(size_t capacity_pow2);
+RingQueue* ring_init_huge(size_t capacity_pow2);
+void ring_destroy(RingQueue* ring);
+void ring_set_destructor(RingQueue* ring, void (*destructor)(void* data, size_t length));
+bool ring_try_enqueue(RingQueue* ring, void* data, size_t length);
+bool ring_try_dequeue(RingQueue* ring, void** data, size_t* length);
+bool ring_try_dequeue_fit(RingQueue* ring, size_t max_length, void** data, size_t* length);
+bool ring_is_empty(RingQueue* ring);
+size_t ring_size(RingQueue* ring);
+size_t ring_capacity(RingQueue* ring);
+
+#endif // RING_H
@@ -0,0 +1,302 @@
+#define _GNU_SOURCE
+#include "sharded.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+static atomic_uint next_thread_lane = 0;
+static _Thread_local unsigned int local_thread_lane = 0;
+static _Thread_local bool thread_lane_assigned = false;
+static _Thread_local size_t local_rotation = 0;  // Next lane for LANE_POLICY_ROUND_ROBIN producers
+
+// Lane index of the calling thread under LANE_POLICY_THREAD
+static inline size_t thread_lane(const ShardedQueue* sq) {
+    if (!thread_lane_assigned) {
+        local_thread_lane = atomic_fetch_add_explicit(&next_thread_lane, 1, memory_order_relaxed);
+        thread_lane_assigned = true;
+    }
+    return local_thread_lane % sq->lane_count;
+}
+
+// Home lane for dequeues (and for enqueues unless the policy rotates)
+static inline size_t home_lane(const ShardedQueue* sq) {
+    if (sq->policy == LANE_POLICY_NUMA) {
+        return (size_t)queue_mem_current_node() % sq->lane_count;
+    }
+#ifdef __linux__
+    if (sq->policy == LANE_POLICY_CPU) {
+        int cpu = sched_getcpu();
+        if (cpu >= 0) {
+            return (size_t)cpu % sq->lane_count;
+        }
+    }
+#endif
+    return thread_lane(sq);
+}
+
+// Lane the calling thread enqueues to
+static inline size_t enqueue_lane(const ShardedQueue* sq) {
+    if (sq->policy == LANE_POLICY_ROUND_ROBIN) {
+        if (local_rotation == 0) {
+            local_rotation = thread_lane(sq) + 1;  // Start threads at different lanes
+        }
+        return local_rotation++ % sq->lane_count;
+    }
+    return home_lane(sq);
+}
+
+// Count an element taken from a lane other than the home lane
+// Each home lane has its own counter, so stealing consumers of different
+// lanes never write the same line
+static inline void count_steal(ShardedQueue* sq, size_t home) {
+#ifndef QUEUE_NO_STATS
+    atomic_fetch_add_explicit(&sq->lane_stats[home].steals, 1, memory_order_relaxed);
+#else
+    (void)sq;
+    (void)home;
+#endif
+}
+
+// Initialize a sharded queue with lane_count lanes of the given mode
+// Any thread may steal from any lane, so lanes must allow several consumers
+// (QUEUE_MODE_MPMC or QUEUE_MODE_SEGMENT)
+ShardedQueue* sharded_queue_init(size_t lane_count, QueueMode mode, LanePolicy policy) {
+    if (lane_count == 0 || (mode != QUEUE_MODE_MPMC && mode != QUEUE_MODE_SEGMENT)) {
+        return NULL;
+    }
+    if (policy != LANE_POLICY_THREAD && policy != LANE_POLICY_CPU && policy != LANE_POLICY_ROUND_ROBIN &&
+        policy != LANE_POLICY_NUMA) {
+        return NULL;
+    }
+    
+    ShardedQueue* sq = (ShardedQueue*)queue_mem_alloc_aligned(_Alignof(ShardedQueue), sizeof(ShardedQueue));
+    if (sq == NULL) {
+        return NULL;
+    }
+    
+    sq->lanes = (Queue**)calloc(lane_count, sizeof(Queue*));
+    if (sq->lanes == NULL) {
+        queue_mem_free_aligned(sq);
+        return NULL;
+    }
+    sq->lane_count = lane_count;
+    sq->policy = policy;
+#ifndef QUEUE_NO_STATS
+    sq->lane_stats = NULL;
+    if (lane_count > SIZE_MAX / sizeof(ShardedLaneStats)) {
+        sharded_queue_destroy(sq);
+        return NULL;
+    }
+    sq->lane_stats = (ShardedLaneStats*)queue_mem_alloc_aligned(_Alignof(ShardedLaneStats),
+                                                                lane_count * sizeof(ShardedLaneStats));
+    if (sq->lane_stats == NULL) {
+        sharded_queue_destroy(sq);
+        return NULL;
+    }
+    for (size_t i = 0; i < lane_count; i++) {
+        atomic_init(&sq->lane_stats[i].steals, 0);
+    }
+#endif
+    
+    // NUMA lanes are spread over the nodes (lanes beyond the last node wrap around)
+    int nodes = queue_mem_numa_nodes();
+    if (nodes > QUEUE_NUMA_MAX_NODES) {
+        nodes = QUEUE_NUMA_MAX_NODES;
+    }
+    for (size_t i = 0; i < lane_count; i++) {
+        sq->lanes[i] = (policy == LANE_POLICY_NUMA) ? queue_init_numa(mode, (int)(i % (size_t)nodes))
+                                                    : queue_init_mode(mode);
+        if (sq->lanes[i] == NULL) {
+            sharded_queue_destroy(sq);
+            return NULL;
+        }
+    }
+    return sq;
+}
+
+// Initialize a sharded queue with one lane per NUMA node (LANE_POLICY_NUMA)
+ShardedQueue* sharded_queue_init_numa(QueueMode mode) {
+    int nodes = queue_mem_numa_nodes();
+    if (nodes > QUEUE_NUMA_MAX_NODES) {
+        nodes = QUEUE_NUMA_MAX_NODES;
+    }
+    return sharded_queue_init((size_t)nodes, mode, LANE_POLICY_NUMA);
+}
+
+// Destroy the sharded queue and every lane
+// Must not be called while other threads are still using it
+void sharded_queue_destroy(ShardedQueue* sq) {
+    if (sq == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < sq->lane_count; i++) {
+        queue_destroy(sq->lanes[i]);
+    }
+    free(sq->lanes);
+#ifndef QUEUE_NO_STATS
+    queue_mem_free_aligned(sq->lane_stats);
+#endif
+    queue_mem_free_aligned(sq);
+}
+
+// Register the function that releases owned payloads left in any lane
+void sharded_queue_set_destructor(ShardedQueue* sq, void (*destructor)(void* data, size_t length)) {
+    if (sq == NULL) {
+        return;
+    }
+    for (size_t i = 0; i < sq->lane_count; i++) {
+        queue_set_destructor(sq->lanes[i], destructor);
+    }
+}
+
+// Enqueue a copy of an element to the calling thread's lane
+bool sharded_queue_enqueue(ShardedQueue* sq, const void* data, size_t length) {
+    if (sq == NULL) {
+        return false;
+    }
+    return queue_enqueue(sq->lanes[enqueue_lane(sq)], data, length);
+}
+
+// Enqueue an element to the calling thread's lane, taking ownership of data
+bool sharded_queue_enqueue_owned(ShardedQueue* sq, void* data, size_t length) {
+    if (sq == NULL) {
+        return false;
+    }
+    return queue_enqueue_owned(sq->lanes[enqueue_lane(sq)], data, length);
+}
+
+// Dequeue from the home lane, stealing from the other lanes if it is empty
+// Victims are scanned starting next to the home lane, so idle consumers of
+// different lanes do not all pile onto the same victim
+bool sharded_queue_dequeue(ShardedQueue* sq, void** data, size_t* length) {
+    if (sq == NULL || data == NULL || length == NULL) {
+        return false;
+    }
+    
+    size_t home = home_lane(sq);
+    if (queue_dequeue(sq->lanes[home], data, length)) {
+        return true;
+    }
+    
+    for (size_t i = 1; i < sq->lane_count; i++) {
+        Queue* victim = sq->lanes[(home + i) % sq->lane_count];
+        if (!queue_is_empty(victim) && queue_dequeue(victim, data, length)) {
+            count_steal(sq, home);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Dequeue into a caller buffer from the home lane, stealing if it is empty
+// Returns false if every lane is empty (*length == 0), or if the element found
+// does not fit (*length is the size needed; the element stays queued)
+bool sharded_queue_dequeue_into(ShardedQueue* sq, void* buffer, size_t capacity, size_t* length) {
+    if (sq == NULL || length == NULL) {
+        return false;
+    }
+    
+    size_t home = home_lane(sq);
+    for (size_t i = 0; i < sq->lane_count; i++) {
+        Queue* lane = sq->lanes[(home + i) % sq->lane_count];
+        if (queue_dequeue_into(lane, buffer, capacity, length)) {
+            if (i > 0) {
+                count_steal(sq, home);
+            }
+            return true;
+        }
+        if (*length != 0) {
+            return false;  // Found an element that does not fit
+        }
+    }
+    return false;
+}
+
+// Lane the calling thread currently treats as home
+size_t sharded_queue_home_lane(ShardedQueue* sq) {
+    if (sq == NULL) {
+        return 0;
+    }
+    return home_lane(sq);
+}
+
+// Check if every lane is empty
+bool sharded_queue_is_empty(ShardedQueue* sq) {
+    if (sq == NULL) {
+        return true;
+    }
+    for (size_t i = 0; i < sq->lane_count; i++) {
+        if (!queue_is_empty(sq->lanes[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Get the total number of elements over all lanes (approximate while in use)
+size_t sharded_queue_size(ShardedQueue* sq) {
+    if (sq == NULL) {
+        return 0;
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < sq->lane_count; i++) {
+        size += queue_size(sq->lanes[i]);
+    }
+    return size;
+}
+
+// Take a snapshot of the statistics summed over all lanes
+bool sharded_queue_get_stats(ShardedQueue* sq, QueueStats* out) {
+    if (sq == NULL || out == NULL) {
+        return false;
+    }
+    
+    memset(out, 0, sizeof(QueueStats));
+    for (size_t i = 0; i < sq->lane_count; i++) {
+        QueueStats lane;
+        queue_get_stats(sq->lanes[i], &lane);
+        out->enqueued += lane.enqueued;
+        out->dequeued += lane.dequeued;
+        out->enqueue_retries += lane.enqueue_retries;
+        out->dequeue_retries += lane.dequeue_retries;
+        out->size += lane.size;
+#ifndef QUEUE_NO_STATS
+        out->steals += atomic_load_explicit(&sq->lane_stats[i].steals, memory_order_relaxed);
+#endif
+    }
+    return true;
+}
+
+// Print aggregate statistics and the size of every lane
+void sharded_queue_print_stats(ShardedQueue* sq) {
+    if (sq == NULL) {
+        printf("Sharded queue is NULL\n");
+        return;
+    }
+    
+    QueueStats stats;
+    sharded_queue_get_stats(sq, &stats);
+    
+    static const char* policy_names[] = { "thread", "cpu", "round-robin", "numa" };
+    
+    printf("Sharded Queue Statistics:\n");
+    printf("  Lanes: %zu (policy: %s)\n", sq->lane_count, policy_names[sq->policy]);
+    printf("  Size: %zu\n", stats.size);
+    printf("  Lane Sizes: [");
+    for (size_t i = 0; i < sq->lane_count; i++) {
+        printf(i == 0 ? "%zu" : ", %zu", queue_size(sq->lanes[i]));
+    }
+    printf("]\n");
+#ifdef QUEUE_NO_STATS
+    printf("  Counters: disabled (built with QUEUE_NO_STATS)\n");
+#else
+    printf("  Enqueue Counter: %llu\n", (unsigned long long)stats.enqueued);
+    printf("  Dequeue Counter: %llu\n", (unsigned long long)stats.dequeued);
+    printf("  Enqueue Retries: %llu\n", (unsigned long long)stats.enqueue_retries);
+    printf("  Dequeue Retries: %llu\n", (unsigned long long)stats.dequeue_retries);
+    printf("  Steals: %llu\n", (unsigned long long)stats.steals);
+#endif
+}
@@ -0,0 +1,62 @@
+#ifndef SHARDED_H
+#define SHARDED_H
+
+#include "queue.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Sharded multi-lane queue (relaxed FIFO)
+//
+// A ShardedQueue spreads its elements over several independent Queue lanes,
+// typically one per core or NUMA node. Producers enqueue to their home lane
+// and consumers dequeue from their home lane first, stealing from the other
+// lanes only when it is empty. Threads with different home lanes never touch
+// the same head or tail, so the single head/tail bottleneck disappears.
+//
+// Ordering is relaxed: elements enqueued to the same lane come out in FIFO
+// order, but there is no order between lanes. With LANE_POLICY_ROUND_ROBIN
+// even the elements of one producer may be dequeued out of order.
+//
+// With LANE_POLICY_NUMA each lane is a queue bound to one NUMA node (see
+// queue_init_numa) and threads use the lane of the node they run on, so
+// elements only cross sockets when a consumer steals from another node's lane.
+
+// How a thread picks its home lane
+typedef enum LanePolicy {
+    LANE_POLICY_THREAD = 0,       // Fixed per thread, assigned round-robin on first use
+    LANE_POLICY_CPU = 1,          // Lane of the CPU the thread is running on (Linux; else THREAD)
+    LANE_POLICY_ROUND_ROBIN = 2,  // Producers rotate over all lanes; consumers as THREAD
+    LANE_POLICY_NUMA = 3,         // Lane of the thread's NUMA node; lane i is placed on node i
+} LanePolicy;
+
+// Steal counter of the consumers whose home is one lane, on its own cache line
+typedef struct ShardedLaneStats {
+    _Alignas(QUEUE_CACHELINE) atomic_uint_fast64_t steals;  // Elements they took from other lanes
+} ShardedLaneStats;
+
+// Sharded queue structure
+typedef struct ShardedQueue {
+    Queue** lanes;            // lane_count independent queues
+    size_t lane_count;
+    LanePolicy policy;        // Fixed at init
+#ifndef QUEUE_NO_STATS
+    ShardedLaneStats* lane_stats;  // lane_count counters, summed by sharded_queue_get_stats
+#endif
+} ShardedQueue;
+
+// Function declarations
+ShardedQueue* sharded_queue_init(size_t lane_count, QueueMode mode, LanePolicy policy);
+ShardedQueue* sharded_queue_init_numa(QueueMode mode);
+void sharded_queue_destroy(ShardedQueue* sq);
+void sharded_queue_set_destructor(ShardedQueue* sq, void (*destructor)(void* data, size_t length));
+bool sharded_queue_enqueue(ShardedQueue* sq, const void* data, size_t length);
+bool sharded_queue_enqueue_owned(ShardedQueue* sq, void* data, size_t length);
+bool sharded_queue_dequeue(ShardedQueue* sq, void** data, size_t* length);
+bool sharded_queue_dequeue_into(ShardedQueue* sq, void* buffer, size_t capacity, size_t* length);
+size_t sharded_queue_home_lane(ShardedQueue* sq);
+bool sharded_queue_is_empty(ShardedQueue* sq);
+size_t sharded_queue_size(ShardedQueue* sq);
+bool sharded_queue_get_stats(ShardedQueue* sq, QueueStats* out);
+void sharded_queue_print_stats(ShardedQueue* sq);
+
+#endif // SHARDED_H
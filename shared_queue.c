@@ -0,0 +1,454 @@
+#define _POSIX_C_SOURCE 200809L
+#include "shared_queue.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Marks an initialized mapping ("LFQSHMQ1")
+#define SHARED_QUEUE_MAGIC UINT64_C(0x4C4651534D485131)
+#define SHARED_QUEUE_VERSION 2
+
+// Slot header; the payload follows it
+typedef struct SharedSlot {
+    _Atomic(uint64_t) sequence;  // Slot is free for position p when sequence == p, full when p + 1
+    _Atomic(uint32_t) length;    // Payload length in bytes (read before the claim by claim_full)
+    uint32_t reserved;           // Length claimed by shared_queue_reserve (commit clamps to it)
+} SharedSlot;
+
+// Processes only agree on the protocol if these are real atomics, not locks
+// private to one address space
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared queue needs lock-free 64-bit atomics");
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "shared queue needs lock-free 32-bit atomics");
+static_assert(sizeof(SharedSlot) == 16, "shared slot header must be 16 bytes");
+static_assert(sizeof(SharedQueueHeader) == 3 * SHARED_QUEUE_ALIGN, "shared queue header layout changed");
+
+// Bytes per slot for the configured payload size (kept a multiple of 8 for the sequence)
+static size_t slot_size_for(uint64_t message_max) {
+    return (sizeof(SharedSlot) + (size_t)message_max + 7) & ~(size_t)7;
+}
+
+// Size of the whole mapping
+static size_t mapping_size_for(size_t capacity, size_t slot_size) {
+    return sizeof(SharedQueueHeader) + capacity * slot_size;
+}
+
+// Slot for a position
+static inline SharedSlot* slot_at(SharedQueue* sq, uint64_t position) {
+    return (SharedSlot*)(sq->slots + (size_t)(position & sq->mask) * sq->slot_size);
+}
+
+// Payload bytes of a slot
+static inline unsigned char* slot_data(SharedSlot* slot) {
+    return (unsigned char*)(slot + 1);
+}
+
+// Build the process-local handle for a mapping
+static SharedQueue* handle_create(void* base, size_t mapping_size) {
+    SharedQueue* sq = (SharedQueue*)malloc(sizeof(SharedQueue));
+    if (sq == NULL) {
+        return NULL;
+    }
+    sq->header = (SharedQueueHeader*)base;
+    sq->slots = (unsigned char*)base + sizeof(SharedQueueHeader);
+    sq->mask = (size_t)sq->header->capacity - 1;
+    sq->slot_size = sq->header->slot_size;
+    sq->mapping_size = mapping_size;
+    return sq;
+}
+
+// Check that a mapping holds a queue this build can use
+static bool header_valid(SharedQueueHeader* header, size_t mapping_size) {
+    if (atomic_load_explicit(&header->ready, memory_order_acquire) == 0) {
+        return false;  // Creator has not finished initializing it
+    }
+    if (header->magic != SHARED_QUEUE_MAGIC || header->version != SHARED_QUEUE_VERSION) {
+        return false;
+    }
+    if (header->message_max != QUEUE_SHARED_MESSAGE_MAX ||
+        header->slot_size != slot_size_for(header->message_max)) {
+        return false;
+    }
+    uint64_t capacity = header->capacity;
+    if (capacity < 2 || (capacity & (capacity - 1)) != 0 ||
+        capacity > (SIZE_MAX - sizeof(SharedQueueHeader)) / header->slot_size) {
+        return false;
+    }
+    return mapping_size >= mapping_size_for((size_t)capacity, header->slot_size);
+}
+
+// Initialize a freshly created (zero-filled) mapping
+static void header_init(SharedQueueHeader* header, size_t capacity, size_t slot_size) {
+    header->magic = SHARED_QUEUE_MAGIC;
+    header->version = SHARED_QUEUE_VERSION;
+    header->slot_size = (uint32_t)slot_size;
+    header->capacity = capacity;
+    header->message_max = QUEUE_SHARED_MESSAGE_MAX;
+    atomic_init(&header->enqueue_pos, 0);
+    atomic_init(&header->dequeue_pos, 0);
+    
+    // Slot i is initially free for position i
+    unsigned char* slots = (unsigned char*)header + sizeof(SharedQueueHeader);
+    for (size_t i = 0; i < capacity; i++) {
+        SharedSlot* slot = (SharedSlot*)(slots + i * slot_size);
+        atomic_init(&slot->sequence, i);
+        atomic_init(&slot->length, 0);
+    }
+    
+    // Publish: attachers check this last-written field first
+    atomic_store_explicit(&header->ready, 1, memory_order_release);
+}
+
+// Create a named shared queue with capacity_pow2 slots (a power of two, at least 2)
+// Fails if an object with that name already exists. On POSIX systems the name
+// must start with '/'; on Windows it may carry a "Local\" or "Global\" prefix.
+SharedQueue* queue_create_shared(const char* name, size_t capacity_pow2) {
+    if (name == NULL || capacity_pow2 < 2 || (capacity_pow2 & (capacity_pow2 - 1)) != 0) {
+        return NULL;
+    }
+    size_t slot_size = slot_size_for(QUEUE_SHARED_MESSAGE_MAX);
+    if (capacity_pow2 > (SIZE_MAX - sizeof(SharedQueueHeader)) / slot_size) {
+        return NULL;
+    }
+    size_t size = mapping_size_for(capacity_pow2, slot_size);
+
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                        (DWORD)((uint64_t)size >> 32), (DWORD)size, name);
+    if (mapping == NULL) {
+        return NULL;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        CloseHandle(mapping);
+        return NULL;
+    }
+    void* base = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (base == NULL) {
+        CloseHandle(mapping);
+        return NULL;
+    }
+#else
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);  // The mapping keeps the object referenced
+    if (base == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+#endif
+    
+    // New mappings are zero-filled, so ready stays 0 until header_init is done
+    header_init((SharedQueueHeader*)base, capacity_pow2, slot_size);
+    
+    SharedQueue* sq = handle_create(base, size);
+    if (sq == NULL) {
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(mapping);
+#else
+        munmap(base, size);
+        shm_unlink(name);
+#endif
+        return NULL;
+    }
+#ifdef _WIN32
+    sq->mapping = mapping;
+#endif
+    return sq;
+}
+
+// Map a shared queue created by another process (or this one)
+// Returns NULL if it does not exist, is still being created, or was created
+// with a different layout or QUEUE_SHARED_MESSAGE_MAX
+SharedQueue* queue_attach(const char* name) {
+    if (name == NULL) {
+        return NULL;
+    }
+
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name);
+    if (mapping == NULL) {
+        return NULL;
+    }
+    // Map the whole object; the region size tells how much that is
+    void* base = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    MEMORY_BASIC_INFORMATION info;
+    if (base == NULL || VirtualQuery(base, &info, sizeof(info)) == 0) {
+        if (base != NULL) {
+            UnmapViewOfFile(base);
+        }
+        CloseHandle(mapping);
+        return NULL;
+    }
+    size_t size = info.RegionSize;
+#else
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SharedQueueHeader)) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+#endif
+    
+    SharedQueue* sq = NULL;
+    if (size >= sizeof(SharedQueueHeader) && header_valid((SharedQueueHeader*)base, size)) {
+        sq = handle_create(base, size);
+    }
+    if (sq == NULL) {
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+        CloseHandle(mapping);
+#else
+        munmap(base, size);
+#endif
+        return NULL;
+    }
+#ifdef _WIN32
+    sq->mapping = mapping;
+#endif
+    return sq;
+}
+
+// Unmap a shared queue from this process (the queue and its contents remain)
+void shared_queue_detach(SharedQueue* sq) {
+    if (sq == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(sq->header);
+    CloseHandle((HANDLE)sq->mapping);
+#else
+    munmap(sq->header, sq->mapping_size);
+#endif
+    free(sq);
+}
+
+// Remove the name of a shared queue; the memory is released once every
+// process has detached
+// Windows releases a mapping when its last handle closes, so this only
+// exists there for symmetry
+bool shared_queue_unlink(const char* name) {
+    if (name == NULL) {
+        return false;
+    }
+#ifdef _WIN32
+    return true;
+#else
+    return shm_unlink(name) == 0;
+#endif
+}
+
+// Claim a free slot for a payload of up to length bytes (returns false if the ring is full)
+// Write the payload to slot->data, then publish it with shared_queue_commit
+bool shared_queue_reserve(SharedQueue* sq, size_t length, SharedQueueSlot* slot) {
+    if (sq == NULL || slot == NULL || length > QUEUE_SHARED_MESSAGE_MAX) {
+        return false;
+    }
+    
+    SharedQueueHeader* header = sq->header;
+    uint64_t pos = atomic_load_explicit(&header->enqueue_pos, memory_order_relaxed);
+    SharedSlot* ring_slot;
+    
+    while (true) {
+        ring_slot = slot_at(sq, pos);
+        uint64_t sequence = atomic_load_explicit(&ring_slot->sequence, memory_order_acquire);
+        int64_t diff = (int64_t)(sequence - pos);
+        
+        if (diff == 0) {
+            // Slot is free for this position: claim it
+            if (atomic_compare_exchange_weak_explicit(&header->enqueue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Slot still holds the element from one lap ago: ring is full
+            return false;
+        } else {
+            // Another producer claimed this position; catch up
+            pos = atomic_load_explicit(&header->enqueue_pos, memory_order_relaxed);
+        }
+    }
+    
+    ring_slot->reserved = (uint32_t)length;
+    slot->data = slot_data(ring_slot);
+    slot->length = length;
+    slot->position = pos;
+    return true;
+}
+
+// Publish a slot claimed with shared_queue_reserve to consumers
+// A length raised above the one reserved is clamped to it, so consumers never
+// read past the slot
+void shared_queue_commit(SharedQueue* sq, const SharedQueueSlot* slot) {
+    if (sq == NULL || slot == NULL) {
+        return;
+    }
+    SharedSlot* ring_slot = slot_at(sq, slot->position);
+    size_t length = slot->length < ring_slot->reserved ? slot->length : ring_slot->reserved;
+    atomic_store_explicit(&ring_slot->length, (uint32_t)length, memory_order_relaxed);
+    atomic_store_explicit(&ring_slot->sequence, slot->position + 1, memory_order_release);
+}
+
+// Claim the oldest full slot, if its payload fits in capacity bytes
+// On a payload that does not fit, *length is set to its size and nothing is claimed
+static bool claim_full(SharedQueue* sq, size_t capacity, SharedSlot** claimed,
+                       uint64_t* position, size_t* length) {
+    SharedQueueHeader* header = sq->header;
+    uint64_t pos = atomic_load_explicit(&header->dequeue_pos, memory_order_relaxed);
+    
+    while (true) {
+        SharedSlot* ring_slot = slot_at(sq, pos);
+        uint64_t sequence = atomic_load_explicit(&ring_slot->sequence, memory_order_acquire);
+        int64_t diff = (int64_t)(sequence - (pos + 1));
+        
+        if (diff == 0) {
+            // Slot is full for this position. The length read is this
+            // element's as long as nobody has taken the position yet, which
+            // the claim (or the recheck) confirms. The header is shared with
+            // other processes, so a length no slot can hold is clamped
+            // before anyone copies it
+            size_t slot_length = atomic_load_explicit(&ring_slot->length, memory_order_relaxed);
+            if (slot_length > QUEUE_SHARED_MESSAGE_MAX) {
+                slot_length = QUEUE_SHARED_MESSAGE_MAX;
+            }
+            if (slot_length > capacity) {
+                uint64_t current = atomic_load_explicit(&header->dequeue_pos, memory_order_relaxed);
+                if (current == pos) {
+                    *length = slot_length;
+                    return false;
+                }
+                pos = current;
+                continue;
+            }
+            if (atomic_compare_exchange_weak_explicit(&header->dequeue_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *claimed = ring_slot;
+                *position = pos;
+                *length = slot_length;
+                return true;
+            }
+        } else if (diff < 0) {
+            // Producer has not published this position yet: ring is empty
+            return false;
+        } else {
+            // Another consumer claimed this position; catch up
+            pos = atomic_load_explicit(&header->dequeue_pos, memory_order_relaxed);
+        }
+    }
+}
+
+// Free a claimed slot for the producer one lap ahead
+static inline void slot_release(SharedQueue* sq, SharedSlot* ring_slot, uint64_t position) {
+    atomic_store_explicit(&ring_slot->sequence, position + sq->mask + 1, memory_order_release);
+}
+
+// Claim the oldest element without copying it (returns false if the ring is empty)
+// slot->data points into the mapping until shared_queue_release
+bool shared_queue_acquire(SharedQueue* sq, SharedQueueSlot* slot) {
+    if (sq == NULL || slot == NULL) {
+        return false;
+    }
+    SharedSlot* ring_slot;
+    uint64_t position;
+    size_t length;
+    if (!claim_full(sq, SIZE_MAX, &ring_slot, &position, &length)) {
+        return false;
+    }
+    slot->data = slot_data(ring_slot);
+    slot->length = length;
+    slot->position = position;
+    return true;
+}
+
+// Return a slot claimed with shared_queue_acquire to producers
+void shared_queue_release(SharedQueue* sq, const SharedQueueSlot* slot) {
+    if (sq == NULL || slot == NULL) {
+        return;
+    }
+    slot_release(sq, slot_at(sq, slot->position), slot->position);
+}
+
+// Copy an element into the ring (returns false if the ring is full or
+// length exceeds QUEUE_SHARED_MESSAGE_MAX)
+bool shared_queue_enqueue(SharedQueue* sq, const void* data, size_t length) {
+    if (data == NULL && length > 0) {
+        return false;
+    }
+    SharedQueueSlot slot;
+    if (!shared_queue_reserve(sq, length, &slot)) {
+        return false;
+    }
+    if (length > 0) {
+        memcpy(slot.data, data, length);
+    }
+    shared_queue_commit(sq, &slot);
+    return true;
+}
+
+// Copy the oldest element into buffer (returns false if the ring is empty)
+// If the element does not fit, it stays queued and *length is set to its size
+bool shared_queue_dequeue_into(SharedQueue* sq, void* buffer, size_t capacity, size_t* length) {
+    if (sq == NULL || length == NULL || (buffer == NULL && capacity > 0)) {
+        return false;
+    }
+    SharedSlot* ring_slot;
+    uint64_t position;
+    *length = 0;
+    if (!claim_full(sq, capacity, &ring_slot, &position, length)) {
+        return false;
+    }
+    if (*length > 0) {
+        memcpy(buffer, slot_data(ring_slot), *length);
+    }
+    slot_release(sq, ring_slot, position);
+    return true;
+}
+
+// Check if the ring is empty
+bool shared_queue_is_empty(SharedQueue* sq) {
+    return shared_queue_size(sq) == 0;
+}
+
+// Get the number of elements in the ring (approximate while it is in use)
+size_t shared_queue_size(SharedQueue* sq) {
+    if (sq == NULL) {
+        return 0;
+    }
+    uint64_t dequeued = atomic_load_explicit(&sq->header->dequeue_pos, memory_order_acquire);
+    uint64_t enqueued = atomic_load_explicit(&sq->header->enqueue_pos, memory_order_acquire);
+    return enqueued > dequeued ? (size_t)(enqueued - dequeued) : 0;
+}
+
+// Get the number of slots
+size_t shared_queue_capacity(SharedQueue* sq) {
+    if (sq == NULL) {
+        return 0;
+    }
+    return sq->mask + 1;
+}
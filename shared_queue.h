@@ -0,0 +1,87 @@
+#ifndef SHARED_QUEUE_H
+#define SHARED_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "queue_mem.h"
+
+// Shared-memory queue for communication between processes
+//
+// A bounded MPMC ring (the same per-slot sequence scheme as ring.h) that
+// lives entirely inside a named shared-memory mapping: shm_open/mmap on
+// POSIX systems, CreateFileMapping/MapViewOfFile on Windows. Payloads are
+// stored in the slots themselves, and slots are found by index rather than
+// by pointer, so every process can map the region at a different address.
+// Once both sides have the mapping, enqueue and dequeue are plain memory
+// operations: no system calls, and with shared_queue_reserve/_acquire no
+// copies either.
+//
+// One process creates the region with queue_create_shared(); others open it
+// with queue_attach(). Any process may produce or consume. A process that
+// dies between reserve and commit (or acquire and release) leaves its slot
+// claimed, which stalls the ring at that slot.
+
+// Largest payload a slot holds (each slot is this plus a 16-byte header)
+// Recorded in the mapping, so processes built with different values refuse
+// to attach to each other
+#ifndef QUEUE_SHARED_MESSAGE_MAX
+#define QUEUE_SHARED_MESSAGE_MAX 240
+#endif
+
+// Alignment of the positions in the mapping
+// A literal rather than QUEUE_CACHELINE, so processes built with different
+// cache-line settings still agree on the layout (128 covers both 64- and
+// 128-byte lines)
+#define SHARED_QUEUE_ALIGN 128
+
+// Layout of the start of the mapping (slots follow it)
+// Only fixed-size types and a fixed alignment, so 32- and 64-bit processes
+// and different QUEUE_CACHELINE builds agree on the layout
+typedef struct SharedQueueHeader {
+    uint64_t magic;              // SHARED_QUEUE_MAGIC once initialized
+    uint32_t version;            // Layout version
+    uint32_t slot_size;          // Bytes per slot (header plus payload)
+    uint64_t capacity;           // Number of slots (a power of two)
+    uint64_t message_max;        // Largest payload in bytes
+    _Atomic(uint32_t) ready;     // Set by the creator after everything else is initialized
+    _Alignas(SHARED_QUEUE_ALIGN) _Atomic(uint64_t) enqueue_pos;  // Next position to fill (producers only)
+    _Alignas(SHARED_QUEUE_ALIGN) _Atomic(uint64_t) dequeue_pos;  // Next position to drain (consumers only)
+} SharedQueueHeader;
+
+// Process-local handle to a mapped shared queue
+typedef struct SharedQueue {
+    SharedQueueHeader* header;   // Start of the mapping in this process
+    unsigned char* slots;        // First slot
+    size_t mask;                 // capacity - 1
+    size_t slot_size;
+    size_t mapping_size;         // Bytes mapped
+#ifdef _WIN32
+    void* mapping;               // File mapping handle
+#endif
+} SharedQueue;
+
+// A claimed slot (between reserve and commit, or acquire and release)
+typedef struct SharedQueueSlot {
+    void* data;                  // Payload bytes inside the mapping
+    size_t length;               // Payload length (producers may lower it before commit; a raise is clamped)
+    uint64_t position;           // Ring position of the slot
+} SharedQueueSlot;
+
+// Function declarations
+SharedQueue* queue_create_shared(const char* name, size_t capacity_pow2);
+SharedQueue* queue_attach(const char* name);
+void shared_queue_detach(SharedQueue* sq);
+bool shared_queue_unlink(const char* name);
+bool shared_queue_enqueue(SharedQueue* sq, const void* data, size_t length);
+bool shared_queue_dequeue_into(SharedQueue* sq, void* buffer, size_t capacity, size_t* length);
+bool shared_queue_reserve(SharedQueue* sq, size_t length, SharedQueueSlot* slot);
+void shared_queue_commit(SharedQueue* sq, const SharedQueueSlot* slot);
+bool shared_queue_acquire(SharedQueue* sq, SharedQueueSlot* slot);
+void shared_queue_release(SharedQueue* sq, const SharedQueueSlot* slot);
+bool shared_queue_is_empty(SharedQueue* sq);
+size_t shared_queue_size(SharedQueue* sq);
+size_t shared_queue_capacity(SharedQueue* sq);
+
+#endif // SHARED_QUEUE_H
@@ -0,0 +1,354 @@
+#define _POSIX_C_SOURCE 200809L
+#include "spill.h"
+#include "reclaim.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Record states
+#define SPILL_PENDING 0u  // Claimed (or not yet claimed) but not written
+#define SPILL_READY   1u  // Published; payload follows the header
+#define SPILL_END     2u  // No more records in this segment
+
+// Smallest segment file accepted by spill_open
+#define SPILL_SEGMENT_MIN 4096
+
+// Attempts at finding an unused segment file name
+#define SPILL_NAME_ATTEMPTS 16
+
+// Header in front of every record
+typedef struct SpillRecord {
+    _Atomic(uint32_t) state;  // SPILL_* state
+    uint32_t flags;           // Caller's flags
+    uint64_t length;          // Payload length in bytes
+} SpillRecord;
+
+// Mapped segment file
+typedef struct SpillSegment {
+    _Alignas(QUEUE_CACHELINE) atomic_size_t reserved;  // Bytes claimed by appenders (may run past size)
+    _Atomic(struct SpillSegment*) next;  // Newer segment
+    unsigned char* base;                 // Start of the mapping
+    size_t size;                         // Bytes mapped
+#ifdef _WIN32
+    HANDLE file;                         // Opened with FILE_FLAG_DELETE_ON_CLOSE
+    HANDLE mapping;
+#endif
+} SpillSegment;
+
+// Bytes taken by a record with a payload of length bytes
+size_t spill_record_size(size_t length) {
+    return sizeof(SpillRecord) + ((length + 7) & ~(size_t)7);
+}
+
+// Largest payload a record can hold in an ordinary segment (larger records
+// get a segment file of their own)
+size_t spill_record_max(SpillLog* log) {
+    if (log == NULL) {
+        return 0;
+    }
+    return log->segment_bytes - sizeof(SpillRecord);
+}
+
+// Unmap a segment and release its file
+static void segment_destroy(SpillSegment* segment) {
+#ifdef _WIN32
+    UnmapViewOfFile(segment->base);
+    CloseHandle(segment->mapping);
+    CloseHandle(segment->file);  // Deletes the file
+#else
+    munmap(segment->base, segment->size);
+#endif
+    queue_mem_free_aligned(segment);
+}
+
+// Reclamation callback for segments the reader has finished with
+static void segment_reclaim(void* ptr) {
+    segment_destroy((SpillSegment*)ptr);
+}
+
+// Create and map a new segment file of size bytes (a multiple of 8)
+static SpillSegment* segment_create(SpillLog* log, size_t size) {
+    SpillSegment* segment = (SpillSegment*)queue_mem_alloc_aligned(_Alignof(SpillSegment), sizeof(SpillSegment));
+    if (segment == NULL) {
+        return NULL;
+    }
+    size_t path_size = strlen(log->directory) + 64;
+    char* path = (char*)malloc(path_size);
+    if (path == NULL) {
+        queue_mem_free_aligned(segment);
+        return NULL;
+    }
+    
+    void* base = NULL;
+    for (int attempt = 0; attempt < SPILL_NAME_ATTEMPTS && base == NULL; attempt++) {
+        size_t sequence = atomic_fetch_add_explicit(&log->next_file, 1, memory_order_relaxed);
+#ifdef _WIN32
+        snprintf(path, path_size, "%s/queue-spill-%lu-%p-%zu.seg", log->directory,
+                 (unsigned long)GetCurrentProcessId(), (void*)log, sequence);
+        HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_NEW,
+                                  FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+        if (file == INVALID_HANDLE_VALUE) {
+            if (GetLastError() == ERROR_FILE_EXISTS) {
+                continue;
+            }
+            break;
+        }
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE,
+                                            (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+        base = (mapping != NULL) ? MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size) : NULL;
+        if (base == NULL) {
+            if (mapping != NULL) {
+                CloseHandle(mapping);
+            }
+            CloseHandle(file);
+            break;
+        }
+        segment->file = file;
+        segment->mapping = mapping;
+#else
+        snprintf(path, path_size, "%s/queue-spill-%ld-%p-%zu.seg", log->directory,
+                 (long)getpid(), (void*)log, sequence);
+        int fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) {
+            if (errno == EEXIST) {
+                continue;
+            }
+            break;
+        }
+        // The mapping keeps the file alive; nothing is left on disk once it is unmapped
+        unlink(path);
+        if (ftruncate(fd, (off_t)size) == 0) {
+            base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (base == MAP_FAILED) {
+                base = NULL;
+            }
+        }
+        close(fd);
+        if (base == NULL) {
+            break;
+        }
+#endif
+    }
+    free(path);
+    
+    if (base == NULL) {
+        queue_mem_free_aligned(segment);
+        return NULL;
+    }
+    
+    // The file starts out zero-filled, so every record is SPILL_PENDING
+    segment->base = (unsigned char*)base;
+    segment->size = size;
+    atomic_init(&segment->reserved, 0);
+    atomic_init(&segment->next, (SpillSegment*)NULL);
+    return segment;
+}
+
+// Open an empty log whose segment files go in directory
+// segment_bytes of 0 selects SPILL_SEGMENT_BYTES. The first segment is
+// created right away, so an unusable directory is reported here.
+SpillLog* spill_open(const char* directory, size_t segment_bytes) {
+    if (directory == NULL) {
+        return NULL;
+    }
+    if (segment_bytes == 0) {
+        segment_bytes = SPILL_SEGMENT_BYTES;
+    }
+    if (segment_bytes < SPILL_SEGMENT_MIN) {
+        segment_bytes = SPILL_SEGMENT_MIN;
+    }
+    segment_bytes &= ~(size_t)7;
+    
+    SpillLog* log = (SpillLog*)queue_mem_alloc_aligned(_Alignof(SpillLog), sizeof(SpillLog));
+    if (log == NULL) {
+        return NULL;
+    }
+    size_t directory_length = strlen(directory);
+    log->directory = (char*)malloc(directory_length + 1);
+    if (log->directory == NULL) {
+        queue_mem_free_aligned(log);
+        return NULL;
+    }
+    memcpy(log->directory, directory, directory_length + 1);
+    log->segment_bytes = segment_bytes;
+    atomic_init(&log->next_file, 0);
+    atomic_init(&log->appended, 0);
+    atomic_init(&log->consumed, 0);
+    log->read_offset = 0;
+    
+    SpillSegment* first = segment_create(log, segment_bytes);
+    if (first == NULL) {
+        free(log->directory);
+        queue_mem_free_aligned(log);
+        return NULL;
+    }
+    atomic_init(&log->tail, first);
+    log->head = first;
+    return log;
+}
+
+// Close a log, passing every record still in it to release (may be NULL)
+// Must not be called while other threads are still using the log
+void spill_close(SpillLog* log, void (*release)(uint32_t flags, const void* data, size_t length, void* ctx),
+                 void* ctx) {
+    if (log == NULL) {
+        return;
+    }
+    
+    uint32_t flags;
+    const void* data;
+    size_t length;
+    while (spill_peek(log, &flags, &data, &length)) {
+        if (release != NULL) {
+            release(flags, data, length, ctx);
+        }
+        spill_pop(log);
+    }
+    
+    SpillSegment* segment = log->head;
+    while (segment != NULL) {
+        SpillSegment* next = atomic_load_explicit(&segment->next, memory_order_acquire);
+        segment_destroy(segment);
+        segment = next;
+    }
+    free(log->directory);
+    queue_mem_free_aligned(log);
+}
+
+// Claim bytes of contiguous space for records (sum of spill_record_size of each)
+// On success the caller writes records into it with spill_write until it is
+// exactly full, then calls spill_finish; nothing may be left unwritten, or the
+// reader stops at the gap. A claim larger than a segment gets a new segment
+// file sized to fit it. Returns false if a new segment file cannot be created.
+bool spill_reserve(SpillLog* log, size_t bytes, SpillReservation* reservation) {
+    if (log == NULL || reservation == NULL || bytes == 0 || (bytes & 7) != 0) {
+        return false;
+    }
+    
+    // Appenders may still hold a segment the reader has retired
+    reclaim_enter();
+    SpillSegment* segment = atomic_load_explicit(&log->tail, memory_order_acquire);
+    while (true) {
+        size_t offset = atomic_fetch_add_explicit(&segment->reserved, bytes, memory_order_relaxed);
+        if (offset + bytes <= segment->size) {
+            reservation->segment = segment;
+            reservation->offset = offset;
+            reservation->end = offset + bytes;
+            reservation->records = 0;
+            return true;  // Critical section ends in spill_finish
+        }
+        
+        // Claims are contiguous, so exactly one appender's claim crosses the
+        // end of the segment; it tells the reader to move on
+        if (offset + sizeof(SpillRecord) <= segment->size) {
+            SpillRecord* record = (SpillRecord*)(segment->base + offset);
+            atomic_store_explicit(&record->state, SPILL_END, memory_order_release);
+        }
+        
+        SpillSegment* next = atomic_load_explicit(&segment->next, memory_order_acquire);
+        if (next == NULL) {
+            SpillSegment* fresh = segment_create(log, bytes > log->segment_bytes ? bytes : log->segment_bytes);
+            if (fresh == NULL) {
+                reclaim_exit();
+                return false;
+            }
+            if (atomic_compare_exchange_strong_explicit(&segment->next, &next, fresh,
+                                                        memory_order_acq_rel,
+                                                        memory_order_acquire)) {
+                next = fresh;
+            } else {
+                segment_destroy(fresh);  // Another appender chained one first; ours was never visible
+            }
+        }
+        
+        // Help the tail forward (failing just means someone else already did)
+        SpillSegment* expected = segment;
+        atomic_compare_exchange_strong_explicit(&log->tail, &expected, next,
+                                                memory_order_release,
+                                                memory_order_relaxed);
+        segment = next;
+    }
+}
+
+// Write and publish the next record of a reservation
+void spill_write(SpillReservation* reservation, uint32_t flags, const void* data, size_t length) {
+    SpillRecord* record = (SpillRecord*)(reservation->segment->base + reservation->offset);
+    record->flags = flags;
+    record->length = length;
+    if (length > 0) {
+        memcpy(record + 1, data, length);
+    }
+    atomic_store_explicit(&record->state, SPILL_READY, memory_order_release);
+    reservation->offset += spill_record_size(length);
+    reservation->records++;
+}
+
+// Finish a reservation once all of its records are written
+void spill_finish(SpillLog* log, SpillReservation* reservation) {
+    atomic_fetch_add_explicit(&log->appended, reservation->records, memory_order_release);
+    reclaim_exit();
+}
+
+// Look at the oldest record without removing it (reader only)
+// Returns false if there is none, or the oldest one is still being written.
+// data points into the mapping and stays valid until spill_pop.
+bool spill_peek(SpillLog* log, uint32_t* flags, const void** data, size_t* length) {
+    if (log == NULL || flags == NULL || data == NULL || length == NULL) {
+        return false;
+    }
+    
+    SpillSegment* segment = log->head;
+    while (true) {
+        if (log->read_offset + sizeof(SpillRecord) <= segment->size) {
+            SpillRecord* record = (SpillRecord*)(segment->base + log->read_offset);
+            uint32_t state = atomic_load_explicit(&record->state, memory_order_acquire);
+            if (state == SPILL_READY) {
+                *flags = record->flags;
+                *data = record + 1;
+                *length = (size_t)record->length;
+                return true;
+            }
+            if (state == SPILL_PENDING) {
+                return false;
+            }
+        }
+        
+        // End of this segment: continue in the next one once it is chained
+        SpillSegment* next = atomic_load_explicit(&segment->next, memory_order_acquire);
+        if (next == NULL) {
+            return false;
+        }
+        log->head = next;
+        log->read_offset = 0;
+        reclaim_retire(segment, segment_reclaim);
+        segment = next;
+    }
+}
+
+// Remove the record spill_peek returned (reader only)
+void spill_pop(SpillLog* log) {
+    if (log == NULL) {
+        return;
+    }
+    SpillRecord* record = (SpillRecord*)(log->head->base + log->read_offset);
+    log->read_offset += spill_record_size((size_t)record->length);
+    atomic_fetch_add_explicit(&log->consumed, 1, memory_order_release);
+}
+
+// Get the number of records in the log (approximate while it is in use)
+size_t spill_count(SpillLog* log) {
+    if (log == NULL) {
+        return 0;
+    }
+    size_t consumed = atomic_load_explicit(&log->consumed, memory_order_acquire);
+    size_t appended = atomic_load_explicit(&log->appended, memory_order_acquire);
+    return appended > consumed ? appended - consumed : 0;
+}
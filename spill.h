@@ -0,0 +1,67 @@
+#ifndef SPILL_H
+#define SPILL_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "queue_mem.h"
+
+// Memory-mapped overflow log (FIFO of records backed by files)
+//
+// Records are appended to segment files mapped into memory, each
+// as a 16-byte header (state, flags, length) followed by the payload padded
+// to 8 bytes. Appenders claim space with one fetch-and-add on the newest
+// segment and publish a record by setting its state; when a segment fills,
+// the appender that crossed its end chains on a new one (sized to fit the
+// claim if that is larger than a segment). Any number of
+// threads may append; one thread at a time reads (the caller serializes
+// readers). Segments are retired through reclaim.h once read, which unmaps
+// them.
+//
+// Segment files are unlinked as soon as they are mapped, so their pages are
+// backed by the file system (and can be written out instead of counting as
+// anonymous memory) and nothing is left behind if the process dies.
+
+// Bytes per segment file
+#ifndef SPILL_SEGMENT_BYTES
+#define SPILL_SEGMENT_BYTES (16u * 1024 * 1024)
+#endif
+
+// Mapped segment file (defined in spill.c)
+struct SpillSegment;
+
+// Overflow log
+typedef struct SpillLog {
+    char* directory;                             // Where segment files are created
+    size_t segment_bytes;                        // Size of each segment file (unless a claim needs more)
+    atomic_size_t next_file;                     // Sequence number for segment file names
+    _Alignas(QUEUE_CACHELINE) _Atomic(struct SpillSegment*) tail;  // Newest segment (appenders; may lag)
+    atomic_size_t appended;                      // Records published so far
+    _Alignas(QUEUE_CACHELINE) struct SpillSegment* head;  // Oldest segment (reader only)
+    size_t read_offset;                          // Next record in head (reader only)
+    atomic_size_t consumed;                      // Records read so far
+} SpillLog;
+
+// Space claimed by spill_reserve for one or more records
+typedef struct SpillReservation {
+    struct SpillSegment* segment;
+    size_t offset;                               // Where the next record goes
+    size_t end;                                  // End of the claimed space
+    size_t records;                              // Records written so far
+} SpillReservation;
+
+// Function declarations
+SpillLog* spill_open(const char* directory, size_t segment_bytes);
+void spill_close(SpillLog* log, void (*release)(uint32_t flags, const void* data, size_t length, void* ctx),
+                 void* ctx);
+size_t spill_record_size(size_t length);
+size_t spill_record_max(SpillLog* log);
+bool spill_reserve(SpillLog* log, size_t bytes, SpillReservation* reservation);
+void spill_write(SpillReservation* reservation, uint32_t flags, const void* data, size_t length);
+void spill_finish(SpillLog* log, SpillReservation* reservation);
+bool spill_peek(SpillLog* log, uint32_t* flags, const void** data, size_t* length);
+void spill_pop(SpillLog* log);
+size_t spill_count(SpillLog* log);
+
+#endif // SPILL_H
@@ -0,0 +1,568 @@
+#define _GNU_SOURCE
+#include "queue.h"
+#include "ring.h"
+#include "sharded.h"
+#include "typed_queue.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Queue stress and correctness test
+//
+// Runs producers and consumers against every queue engine and checks what
+// comes out. Each producer enqueues its own sequence 0, 1, 2, ... tagged with
+// its id, mixing single and batch enqueues. Consumers mix single, batch and
+// copy-out dequeues and check three things. Each producer's elements must
+// reach each consumer in increasing order (per-producer FIFO, which every
+// engine here guarantees). No element may arrive twice. After the threads
+// join, every element must have been seen. Each line also reports the CAS
+// retries per element from queue_get_stats, so retry rates can be compared
+// across thread counts.
+//
+// Two runs cover the paths where consumers interact most. In wait/close the
+// consumers park in queue_dequeue_wait and stop only when it reports the end
+// of the stream, which the last producer signals with queue_close. In
+// dequeue-if the elements are larger than QUEUE_INLINE_MAX, so their payloads
+// live on the heap, and consumers alternate queue_peek with queue_dequeue_if,
+// whose predicate reads the whole payload while other consumers claim
+// elements.
+//
+// Build with `make stress`, or `make stress-tsan` / `make stress-asan` for
+// the sanitizer builds. The exit status is 0 only if every run passed.
+//
+// Usage: queue_stress [elements per producer] [--quick]
+
+// Ring capacity used for the ring runs
+#define STRESS_RING_CAPACITY 1024
+
+// Largest batch a thread enqueues or dequeues at once
+#define STRESS_MAX_BATCH 8
+
+// Element: which producer sent it and where in that producer's sequence
+typedef struct StressItem {
+    uint64_t seq;
+    uint32_t producer;
+    uint32_t check;           // ~producer, to catch torn copies
+} StressItem;
+
+DEFINE_TYPED_QUEUE(stress_ring, StressItem)
+
+// Element of the dequeue-if run: padded past QUEUE_INLINE_MAX so the queue
+// keeps it on the heap, with padding derived from the header
+#define STRESS_HEAP_BYTES (QUEUE_INLINE_MAX + 64)
+
+typedef struct StressHeapItem {
+    StressItem item;
+    unsigned char fill[STRESS_HEAP_BYTES - sizeof(StressItem)];
+} StressHeapItem;
+
+// Queue implementation under test
+typedef enum StressKind {
+    STRESS_LIST_MPMC,
+    STRESS_LIST_MPSC,
+    STRESS_LIST_SPSC,
+    STRESS_SEGMENT,
+    STRESS_PRIORITY,
+    STRESS_SHARDED,
+    STRESS_RING,
+    STRESS_TYPED_RING,
+    STRESS_WAIT_CLOSE,        // MPMC list, blocking consumers, ended by queue_close
+    STRESS_DEQUEUE_IF,        // MPMC list, heap payloads, queue_peek and queue_dequeue_if
+} StressKind;
+
+static const char* kind_names[] = {
+    "list/mpmc", "list/mpsc", "list/spsc", "segment", "priority", "sharded", "ring", "typed-ring",
+    "wait/close", "dequeue-if"
+};
+
+// One run
+typedef struct StressConfig {
+    StressKind kind;
+    int producers;
+    int consumers;
+    size_t elements;          // Elements per producer
+} StressConfig;
+
+// State shared by the threads of one run
+typedef struct StressRun {
+    const StressConfig* config;
+    Queue* queue;
+    ShardedQueue* sharded;
+    RingQueue* ring;
+    stress_ring* typed;
+    atomic_uchar* seen;       // producers * elements flags, set on delivery
+    atomic_int ready;         // Threads at the start line
+    atomic_bool go;           // Start signal
+    atomic_int producers_left;
+    atomic_uint_fast64_t duplicates;
+    atomic_uint_fast64_t reordered;
+    atomic_uint_fast64_t corrupt;
+} StressRun;
+
+// Per-thread arguments
+typedef struct StressThread {
+    StressRun* run;
+    int id;                   // Producer id, or consumer index
+    bool producer;
+    uint64_t elements;        // Elements sent or received
+} StressThread;
+
+// Padding byte i of a heap element
+static inline unsigned char heap_fill(const StressItem* item, size_t i) {
+    return (unsigned char)(item->seq * 31 + item->producer + i);
+}
+
+static void heap_item_make(StressHeapItem* heap, const StressItem* item) {
+    heap->item = *item;
+    for (size_t i = 0; i < sizeof(heap->fill); i++) {
+        heap->fill[i] = heap_fill(item, i);
+    }
+}
+
+// Check that a heap element arrived whole
+static bool heap_item_intact(const void* data, size_t length) {
+    if (length != sizeof(StressHeapItem)) {
+        return false;
+    }
+    const StressHeapItem* heap = (const StressHeapItem*)data;
+    for (size_t i = 0; i < sizeof(heap->fill); i++) {
+        if (heap->fill[i] != heap_fill(&heap->item, i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// dequeue-if predicate: read the whole payload, count it if torn, accept it
+static bool heap_pred(const void* data, size_t length, void* ctx) {
+    if (!heap_item_intact(data, length)) {
+        atomic_fetch_add_explicit(&((StressRun*)ctx)->corrupt, 1, memory_order_relaxed);
+    }
+    return true;
+}
+
+static inline uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Wait until every thread of the run is ready
+static void start_line(StressRun* run) {
+    atomic_fetch_add(&run->ready, 1);
+    while (!atomic_load_explicit(&run->go, memory_order_acquire)) {
+        sched_yield();
+    }
+}
+
+// Check one delivered element against the consumer's view of its producer
+// last[p] is one past the highest sequence this consumer has seen from p
+static void check_item(StressRun* run, uint64_t* last, const StressItem* item) {
+    const StressConfig* config = run->config;
+    if (item->producer >= (uint32_t)config->producers || item->check != ~item->producer ||
+        item->seq >= config->elements) {
+        atomic_fetch_add_explicit(&run->corrupt, 1, memory_order_relaxed);
+        return;
+    }
+    if (item->seq < last[item->producer]) {
+        atomic_fetch_add_explicit(&run->reordered, 1, memory_order_relaxed);
+    } else {
+        last[item->producer] = item->seq + 1;
+    }
+    size_t index = (size_t)item->producer * config->elements + (size_t)item->seq;
+    if (atomic_fetch_add_explicit(&run->seen[index], 1, memory_order_relaxed) != 0) {
+        atomic_fetch_add_explicit(&run->duplicates, 1, memory_order_relaxed);
+    }
+}
+
+// Ring elements are references; the sequence and producer travel in the
+// pointer and length themselves (the pointer is never dereferenced)
+static inline void* ring_encode(const StressItem* item) {
+    return (void*)(uintptr_t)(item->seq + 1);
+}
+
+static inline StressItem ring_decode(void* data, size_t length) {
+    StressItem item = { (uint64_t)(uintptr_t)data - 1, (uint32_t)length, ~(uint32_t)length };
+    return item;
+}
+
+static void* producer_main(void* arg) {
+    StressThread* self = (StressThread*)arg;
+    StressRun* run = self->run;
+    const StressConfig* config = run->config;
+    
+    StressItem items[STRESS_MAX_BATCH];
+    StressHeapItem heap_items[STRESS_MAX_BATCH];
+    const void* pointers[STRESS_MAX_BATCH];
+    size_t lengths[STRESS_MAX_BATCH];
+    bool heap = config->kind == STRESS_DEQUEUE_IF;
+    for (size_t i = 0; i < STRESS_MAX_BATCH; i++) {
+        pointers[i] = heap ? (const void*)&heap_items[i] : (const void*)&items[i];
+        lengths[i] = heap ? sizeof(StressHeapItem) : sizeof(StressItem);
+    }
+    
+    start_line(run);
+    
+    uint64_t seq = 0;
+    while (seq < config->elements) {
+        // Every fourth call is a batch of up to STRESS_MAX_BATCH elements
+        size_t n = (seq / STRESS_MAX_BATCH) % 4 == 3 ? STRESS_MAX_BATCH : 1;
+        if (n > config->elements - seq) {
+            n = config->elements - seq;
+        }
+        for (size_t i = 0; i < n; i++) {
+            items[i].seq = seq + i;
+            items[i].producer = (uint32_t)self->id;
+            items[i].check = ~(uint32_t)self->id;
+            if (heap) {
+                heap_item_make(&heap_items[i], &items[i]);
+            }
+        }
+        
+        switch (config->kind) {
+            case STRESS_RING:
+                for (size_t i = 0; i < n; i++) {
+                    while (!ring_try_enqueue(run->ring, ring_encode(&items[i]), (size_t)self->id)) {
+                        sched_yield();
+                    }
+                }
+                break;
+            case STRESS_TYPED_RING:
+                for (size_t i = 0; i < n; i++) {
+                    while (!stress_ring_try_enqueue(run->typed, items[i])) {
+                        sched_yield();
+                    }
+                }
+                break;
+            case STRESS_SHARDED:
+                for (size_t i = 0; i < n; i++) {
+                    while (!sharded_queue_enqueue(run->sharded, &items[i], sizeof(StressItem))) {
+                        sched_yield();
+                    }
+                }
+                break;
+            case STRESS_PRIORITY:
+                // One level per producer keeps its elements in FIFO order
+                for (size_t i = 0; i < n; i++) {
+                    while (!queue_enqueue_priority(run->queue, &items[i], sizeof(StressItem),
+                                                   (unsigned int)self->id % QUEUE_PRIORITY_LEVELS)) {
+                        sched_yield();
+                    }
+                }
+                break;
+            default:
+                if (n == 1) {
+                    while (!queue_enqueue(run->queue, pointers[0], lengths[0])) {
+                        sched_yield();
+                    }
+                } else {
+                    while (!queue_enqueue_batch(run->queue, pointers, lengths, n)) {
+                        sched_yield();
+                    }
+                }
+                break;
+        }
+        seq += n;
+    }
+    
+    self->elements = seq;
+    if (atomic_fetch_sub_explicit(&run->producers_left, 1, memory_order_acq_rel) == 1 &&
+        config->kind == STRESS_WAIT_CLOSE) {
+        // Last producer: end the stream, which wakes every parked consumer
+        queue_close(run->queue);
+        if (queue_enqueue(run->queue, &items[0], sizeof(StressItem))) {
+            atomic_fetch_add_explicit(&run->corrupt, 1, memory_order_relaxed);  // Must be rejected
+        }
+    }
+    return NULL;
+}
+
+// Take up to STRESS_MAX_BATCH elements, rotating over the dequeue calls
+// Returns the number of elements copied to items
+static size_t consume(StressRun* run, unsigned int round, StressItem* items) {
+    void* out[STRESS_MAX_BATCH];
+    size_t lens[STRESS_MAX_BATCH];
+    size_t n = 0;
+    
+    switch (run->config->kind) {
+        case STRESS_RING:
+            while (n < STRESS_MAX_BATCH && ring_try_dequeue(run->ring, &out[n], &lens[n])) {
+                items[n] = ring_decode(out[n], lens[n]);
+                n++;
+            }
+            return n;
+        case STRESS_TYPED_RING:
+            while (n < STRESS_MAX_BATCH && stress_ring_try_dequeue(run->typed, &items[n])) {
+                n++;
+            }
+            return n;
+        case STRESS_WAIT_CLOSE:
+            // Returns QUEUE_WAIT_CLOSED (n == 0) only once the queue is closed and drained
+            n = queue_dequeue_wait(run->queue, &out[0], &lens[0], QUEUE_WAIT_FOREVER) == QUEUE_WAIT_OK ? 1 : 0;
+            break;
+        case STRESS_DEQUEUE_IF:
+            if (round % 2 == 0) {
+                StressHeapItem peeked;
+                size_t length;
+                if (queue_peek(run->queue, &peeked, sizeof(peeked), &length) &&
+                    !heap_item_intact(&peeked, length)) {
+                    atomic_fetch_add_explicit(&run->corrupt, 1, memory_order_relaxed);
+                }
+            }
+            if (!queue_dequeue_if(run->queue, heap_pred, run, &out[0], &lens[0])) {
+                return 0;
+            }
+            if (!heap_item_intact(out[0], lens[0])) {
+                lens[0] = 0;  // Flagged as corrupt below
+            }
+            n = 1;
+            break;
+        case STRESS_SHARDED:
+            if (round % 2 == 0) {
+                size_t length;
+                return sharded_queue_dequeue_into(run->sharded, &items[0], sizeof(StressItem), &length) ? 1 : 0;
+            }
+            n = sharded_queue_dequeue(run->sharded, &out[0], &lens[0]) ? 1 : 0;
+            break;
+        default:
+            switch (round % 3) {
+                case 0: {
+                    size_t length;
+                    return queue_dequeue_into(run->queue, &items[0], sizeof(StressItem), &length) ? 1 : 0;
+                }
+                case 1:
+                    n = queue_dequeue(run->queue, &out[0], &lens[0]) ? 1 : 0;
+                    break;
+                default:
+                    n = queue_dequeue_batch(run->queue, out, lens, STRESS_MAX_BATCH);
+                    break;
+            }
+            break;
+    }
+    
+    // Heap copies from the list and sharded queues
+    for (size_t i = 0; i < n; i++) {
+        if (lens[i] == sizeof(StressItem) || lens[i] == sizeof(StressHeapItem)) {
+            memcpy(&items[i], out[i], sizeof(StressItem));
+        } else {
+            memset(&items[i], 0xff, sizeof(StressItem));  // Flagged as corrupt
+        }
+        free(out[i]);
+    }
+    return n;
+}
+
+static void* consumer_main(void* arg) {
+    StressThread* self = (StressThread*)arg;
+    StressRun* run = self->run;
+    
+    uint64_t* last = (uint64_t*)calloc((size_t)run->config->producers, sizeof(uint64_t));
+    if (last == NULL) {
+        abort();
+    }
+    StressItem items[STRESS_MAX_BATCH];
+    
+    start_line(run);
+    
+    uint64_t received = 0;
+    unsigned int round = (unsigned int)self->id;
+    while (true) {
+        // Read before trying, so an empty result after the last producer
+        // finished really means the queue is drained
+        bool producers_done = atomic_load_explicit(&run->producers_left, memory_order_acquire) == 0;
+        
+        size_t n = consume(run, round++, items);
+        if (n == 0) {
+            if (producers_done) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        for (size_t i = 0; i < n; i++) {
+            check_item(run, last, &items[i]);
+        }
+        received += n;
+    }
+    
+    free(last);
+    self->elements = received;
+    return NULL;
+}
+
+// Run one configuration and print its report line; returns true if it passed
+static bool stress_run(const StressConfig* config) {
+    StressRun run;
+    memset(&run, 0, sizeof(run));
+    run.config = config;
+    atomic_init(&run.ready, 0);
+    atomic_init(&run.go, false);
+    atomic_init(&run.producers_left, config->producers);
+    atomic_init(&run.duplicates, 0);
+    atomic_init(&run.reordered, 0);
+    atomic_init(&run.corrupt, 0);
+    
+    size_t total_elements = (size_t)config->producers * config->elements;
+    run.seen = (atomic_uchar*)calloc(total_elements, sizeof(atomic_uchar));
+    if (run.seen == NULL) {
+        return false;
+    }
+    
+    switch (config->kind) {
+        case STRESS_RING:
+            run.ring = ring_init(STRESS_RING_CAPACITY);
+            break;
+        case STRESS_TYPED_RING:
+            run.typed = stress_ring_init(STRESS_RING_CAPACITY);
+            break;
+        case STRESS_SHARDED: {
+            // One lane per thread on the busier side; LANE_POLICY_THREAD keeps
+            // each producer on one lane, so its elements stay in order
+            int lanes = config->producers > config->consumers ? config->producers : config->consumers;
+            run.sharded = sharded_queue_init((size_t)lanes, QUEUE_MODE_MPMC, LANE_POLICY_THREAD);
+            break;
+        }
+        default: {
+            QueueMode mode = config->kind == STRESS_LIST_SPSC ? QUEUE_MODE_SPSC
+                           : config->kind == STRESS_LIST_MPSC ? QUEUE_MODE_MPSC
+                           : config->kind == STRESS_SEGMENT ? QUEUE_MODE_SEGMENT
+                           : config->kind == STRESS_PRIORITY ? QUEUE_MODE_PRIORITY : QUEUE_MODE_MPMC;
+            run.queue = queue_init_mode(mode);
+            break;
+        }
+    }
+    
+    int total = config->producers + config->consumers;
+    StressThread* threads = (StressThread*)calloc((size_t)total, sizeof(StressThread));
+    pthread_t* handles = (pthread_t*)calloc((size_t)total, sizeof(pthread_t));
+    if ((run.queue == NULL && run.sharded == NULL && run.ring == NULL && run.typed == NULL) ||
+        threads == NULL || handles == NULL) {
+        free(threads);
+        free(handles);
+        free(run.seen);
+        queue_destroy(run.queue);
+        sharded_queue_destroy(run.sharded);
+        ring_destroy(run.ring);
+        stress_ring_destroy(run.typed);
+        return false;
+    }
+    
+    for (int i = 0; i < total; i++) {
+        threads[i].run = &run;
+        threads[i].producer = i < config->producers;
+        threads[i].id = threads[i].producer ? i : i - config->producers;
+        pthread_create(&handles[i], NULL, threads[i].producer ? producer_main : consumer_main, &threads[i]);
+    }
+    
+    while (atomic_load(&run.ready) < total) {
+        sched_yield();
+    }
+    uint64_t start = now_ns();
+    atomic_store_explicit(&run.go, true, memory_order_release);
+    for (int i = 0; i < total; i++) {
+        pthread_join(handles[i], NULL);
+    }
+    uint64_t elapsed = now_ns() - start;
+    
+    uint64_t received = 0;
+    for (int i = 0; i < total; i++) {
+        if (!threads[i].producer) {
+            received += threads[i].elements;
+        }
+    }
+    uint64_t lost = 0;
+    for (size_t i = 0; i < total_elements; i++) {
+        if (atomic_load_explicit(&run.seen[i], memory_order_relaxed) == 0) {
+            lost++;
+        }
+    }
+    uint64_t duplicates = atomic_load(&run.duplicates);
+    uint64_t reordered = atomic_load(&run.reordered);
+    uint64_t corrupt = atomic_load(&run.corrupt);
+    bool passed = lost == 0 && duplicates == 0 && reordered == 0 && corrupt == 0 && received == total_elements;
+    
+    double enq_retries = 0.0;
+    double deq_retries = 0.0;
+    if (run.queue != NULL || run.sharded != NULL) {
+        QueueStats stats;
+        if (run.queue != NULL) {
+            queue_get_stats(run.queue, &stats);
+        } else {
+            sharded_queue_get_stats(run.sharded, &stats);
+        }
+        if (total_elements > 0) {
+            enq_retries = (double)stats.enqueue_retries / (double)total_elements;
+            deq_retries = (double)stats.dequeue_retries / (double)total_elements;
+        }
+    }
+    
+    printf("%-10s %2d %2d %9zu %8.2f %8.3f %8.3f %6llu %6llu %6llu %6llu  %s\n",
+           kind_names[config->kind], config->producers, config->consumers, total_elements,
+           elapsed > 0 ? (double)received * 1000.0 / (double)elapsed : 0.0,
+           enq_retries, deq_retries,
+           (unsigned long long)lost, (unsigned long long)duplicates,
+           (unsigned long long)reordered, (unsigned long long)corrupt,
+           passed ? "ok" : "FAIL");
+    fflush(stdout);
+    
+    free(threads);
+    free(handles);
+    free(run.seen);
+    queue_destroy(run.queue);
+    sharded_queue_destroy(run.sharded);
+    ring_destroy(run.ring);
+    stress_ring_destroy(run.typed);
+    return passed;
+}
+
+int main(int argc, char** argv) {
+    size_t elements = 250000;
+    bool quick = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else {
+            elements = (size_t)strtoull(argv[i], NULL, 10);
+        }
+    }
+    if (elements == 0) {
+        fprintf(stderr, "usage: %s [elements per producer] [--quick]\n", argv[0]);
+        return 1;
+    }
+    
+    // Producer/consumer counts: balanced, then fan-in and fan-out
+    static const int thread_counts[][2] = { { 1, 1 }, { 2, 2 }, { 4, 1 }, { 1, 4 }, { 4, 4 }, { 8, 8 } };
+    size_t variants = quick ? 3 : sizeof(thread_counts) / sizeof(thread_counts[0]);
+    
+    printf("Queue stress test: %zu elements per producer\n", elements);
+    printf("Throughput in million elements per second, CAS retries per element\n\n");
+    printf("%-10s %2s %2s %9s %8s %8s %8s %6s %6s %6s %6s  %s\n",
+           "queue", "P", "C", "elements", "Mops/s", "enq-rt", "deq-rt", "lost", "dup", "order", "bad", "result");
+    
+    int failures = 0;
+    for (size_t v = 0; v < variants; v++) {
+        StressConfig config;
+        config.producers = thread_counts[v][0];
+        config.consumers = thread_counts[v][1];
+        config.elements = elements;
+        
+        for (int kind = STRESS_LIST_MPMC; kind <= STRESS_DEQUEUE_IF; kind++) {
+            if (kind == STRESS_LIST_MPSC && config.consumers != 1) {
+                continue;
+            }
+            if (kind == STRESS_LIST_SPSC && (config.producers != 1 || config.consumers != 1)) {
+                continue;
+            }
+            config.kind = (StressKind)kind;
+            if (!stress_run(&config)) {
+                failures++;
+            }
+        }
+    }
+    
+    printf("\n%s: %d failed run%s\n", failures == 0 ? "PASSED" : "FAILED", failures, failures == 1 ? "" : "s");
+    return failures == 0 ? 0 : 1;
+}
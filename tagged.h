@@ -0,0 +1,150 @@
+#ifndef TAGGED_H
+#define TAGGED_H
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Tagged pointers (ABA protection for a CAS on a pointer)
+//
+// A CAS on a bare pointer also succeeds when the pointer has merely come back
+// to the same value, even if the object behind it was popped and pushed again
+// in the meantime (the ABA problem). A tagged pointer pairs the pointer with
+// a counter that every successful CAS increments, so such a CAS fails.
+//
+// The representation is chosen at compile time (override with
+// -DQUEUE_TAGGED_MODE=QUEUE_TAGGED_...):
+// - QUEUE_TAGGED_DWCAS: pointer and a full-width tag side by side, updated
+//   with a double-width CAS (cmpxchg16b on x86-64 built with -mcx16, casp on
+//   AArch64 built for ARMv8.1, _InterlockedCompareExchange128 on MSVC x64)
+// - QUEUE_TAGGED_PACKED: a 16-bit tag in the unused top bits of a 64-bit
+//   pointer (user addresses on x86-64 and AArch64 fit in 48 bits), updated
+//   with an ordinary 64-bit CAS. The tag wraps after 65536 updates, so a
+//   thread would have to stall across exactly that many for ABA to slip by.
+// - QUEUE_TAGGED_NONE: not available; callers keep their epoch-based path
+//
+// Objects pointed to must stay mapped while a stale reader may dereference
+// them (type-stable memory such as never-freed slabs): the tag only makes the
+// CAS fail, it does not keep the object alive.
+
+#define QUEUE_TAGGED_NONE   0
+#define QUEUE_TAGGED_PACKED 1
+#define QUEUE_TAGGED_DWCAS  2
+
+#ifndef QUEUE_TAGGED_MODE
+#if defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16) || (defined(_MSC_VER) && defined(_M_X64))
+#define QUEUE_TAGGED_MODE QUEUE_TAGGED_DWCAS
+#elif defined(__x86_64__) || defined(__aarch64__) || defined(_M_X64) || defined(_M_ARM64)
+#define QUEUE_TAGGED_MODE QUEUE_TAGGED_PACKED
+#else
+#define QUEUE_TAGGED_MODE QUEUE_TAGGED_NONE
+#endif
+#endif
+
+// Pointer with ABA prevention version counter (a snapshot of an AtomicPointerWithABA)
+typedef struct PointerWithABA {
+    struct Node* ptr;     // The actual pointer
+    uintptr_t aba;        // ABA version counter (incremented on each pointer change)
+} PointerWithABA;
+
+// The double-width CAS compares and swaps both fields at once
+static_assert(sizeof(PointerWithABA) == 2 * sizeof(void*), "PointerWithABA must be exactly two words");
+
+#if QUEUE_TAGGED_MODE == QUEUE_TAGGED_DWCAS
+
+// Shared tagged pointer: both words, aligned for the double-width CAS
+typedef struct AtomicPointerWithABA {
+    _Alignas(2 * sizeof(void*)) struct Node* ptr;
+    uintptr_t aba;
+} AtomicPointerWithABA;
+
+// Load a snapshot
+// The halves are read separately (a 16-byte load would need a locked
+// instruction); the tag is read first, and since it only ever grows, a torn
+// snapshot can never compare equal in a later CAS
+static inline PointerWithABA tagged_load(AtomicPointerWithABA* obj) {
+    PointerWithABA value;
+#ifdef _MSC_VER
+    value.aba = *(volatile uintptr_t*)&obj->aba;  // Volatile loads are acquire on x64
+    value.ptr = *(struct Node* volatile*)&obj->ptr;
+#else
+    value.aba = __atomic_load_n(&obj->aba, __ATOMIC_ACQUIRE);
+    value.ptr = __atomic_load_n(&obj->ptr, __ATOMIC_ACQUIRE);
+#endif
+    return value;
+}
+
+// Replace *expected with {desired, expected->aba + 1} if the pointer still holds *expected
+// On failure *expected is refreshed with the current value
+static inline bool tagged_compare_exchange(AtomicPointerWithABA* obj, PointerWithABA* expected,
+                                           struct Node* desired) {
+#ifdef _MSC_VER
+    __int64 comparand[2] = { (__int64)(uintptr_t)expected->ptr, (__int64)expected->aba };
+    if (_InterlockedCompareExchange128((volatile __int64*)obj, (__int64)(expected->aba + 1),
+                                       (__int64)(uintptr_t)desired, comparand)) {
+        return true;
+    }
+    expected->ptr = (struct Node*)(uintptr_t)comparand[0];
+    expected->aba = (uintptr_t)comparand[1];
+    return false;
+#else
+    unsigned __int128 old_value = ((unsigned __int128)expected->aba << 64) | (uintptr_t)expected->ptr;
+    unsigned __int128 new_value = ((unsigned __int128)(expected->aba + 1) << 64) | (uintptr_t)desired;
+    unsigned __int128 seen = __sync_val_compare_and_swap((unsigned __int128*)obj, old_value, new_value);
+    if (seen == old_value) {
+        return true;
+    }
+    expected->ptr = (struct Node*)(uintptr_t)seen;
+    expected->aba = (uintptr_t)(seen >> 64);
+    return false;
+#endif
+}
+
+#elif QUEUE_TAGGED_MODE == QUEUE_TAGGED_PACKED
+
+// Bits of a user-space pointer; the tag lives above them
+#define TAGGED_POINTER_BITS 48
+#define TAGGED_POINTER_MASK ((UINT64_C(1) << TAGGED_POINTER_BITS) - 1)
+
+// Shared tagged pointer: tag and pointer packed into one word
+typedef struct AtomicPointerWithABA {
+    _Atomic(uint64_t) word;
+} AtomicPointerWithABA;
+
+static inline PointerWithABA tagged_unpack(uint64_t word) {
+    PointerWithABA value;
+    value.ptr = (struct Node*)(uintptr_t)(word & TAGGED_POINTER_MASK);
+    value.aba = (uintptr_t)(word >> TAGGED_POINTER_BITS);
+    return value;
+}
+
+static inline uint64_t tagged_pack(struct Node* ptr, uintptr_t aba) {
+    return ((uint64_t)aba << TAGGED_POINTER_BITS) | ((uint64_t)(uintptr_t)ptr & TAGGED_POINTER_MASK);
+}
+
+// Load a snapshot
+static inline PointerWithABA tagged_load(AtomicPointerWithABA* obj) {
+    return tagged_unpack(atomic_load_explicit(&obj->word, memory_order_acquire));
+}
+
+// Replace *expected with {desired, expected->aba + 1} if the pointer still holds *expected
+// On failure *expected is refreshed with the current value
+static inline bool tagged_compare_exchange(AtomicPointerWithABA* obj, PointerWithABA* expected,
+                                           struct Node* desired) {
+    uint64_t old_word = tagged_pack(expected->ptr, expected->aba);
+    if (atomic_compare_exchange_strong_explicit(&obj->word, &old_word, tagged_pack(desired, expected->aba + 1),
+                                                memory_order_acq_rel,
+                                                memory_order_acquire)) {
+        return true;
+    }
+    *expected = tagged_unpack(old_word);
+    return false;
+}
+
+#endif
+
+#endif // TAGGED_H
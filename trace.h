@@ -0,0 +1,87 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "eventcount.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+// Hot-path instrumentation (build with -DQUEUE_TRACE)
+//
+// With QUEUE_TRACE every node carries the timestamp of its enqueue, and each
+// dequeue adds the time the element spent queued to a residency histogram.
+// Each enqueue and dequeue call also adds its number of CAS retries to a
+// retry histogram. Histograms live in the queue's statistics shards, so
+// tracing adds no shared counter, and queue_get_trace() sums them into a
+// QueueTrace. Without QUEUE_TRACE none of this is compiled in.
+//
+// Every histogram has QUEUE_TRACE_BUCKETS log2 buckets: bucket 0 counts the
+// value 0, bucket i counts values in [2^(i-1), 2^i), and the last bucket also
+// takes everything larger.
+//
+// Timestamps are raw ticks: the TSC on x86, the virtual counter on AArch64,
+// and nanoseconds elsewhere. QueueTrace.ticks_per_ns converts them.
+//
+// The enqueue and dequeue paths also fire tracepoints through
+// QUEUE_TRACE_PROBE(name, queue, arg1, arg2): enqueue(queue, elements,
+// retries) once per enqueue call and dequeue(queue, length, ticks queued)
+// once per element. Where <sys/sdt.h> is available these are USDT probes
+// (provider "lfqueue") that perf, bpftrace or SystemTap can attach to, and
+// that cost one nop until they do. Define QUEUE_TRACE_PROBE yourself to route
+// them to LTTng or any other tracer.
+
+#ifndef QUEUE_TRACE_BUCKETS
+#define QUEUE_TRACE_BUCKETS 32
+#endif
+
+#ifdef QUEUE_TRACE
+
+// Current timestamp in ticks
+static inline uint64_t trace_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+    return (uint64_t)__rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    return eventcount_now_ns();
+#endif
+}
+
+// Histogram bucket of a value
+static inline unsigned int trace_bucket(uint64_t value) {
+    if (value == 0) {
+        return 0;
+    }
+#if defined(__GNUC__)
+    unsigned int bucket = 64 - (unsigned int)__builtin_clzll(value);
+#else
+    unsigned int bucket = 0;
+    while (value != 0) {
+        value >>= 1;
+        bucket++;
+    }
+#endif
+    return bucket < QUEUE_TRACE_BUCKETS ? bucket : QUEUE_TRACE_BUCKETS - 1;
+}
+
+#ifndef QUEUE_TRACE_PROBE
+#if defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define QUEUE_TRACE_PROBE(name, queue, arg1, arg2) DTRACE_PROBE3(lfqueue, name, queue, arg1, arg2)
+#endif
+#endif
+#endif
+
+#endif // QUEUE_TRACE
+
+#ifndef QUEUE_TRACE_PROBE
+#define QUEUE_TRACE_PROBE(name, queue, arg1, arg2) ((void)0)
+#endif
+
+#endif // TRACE_H
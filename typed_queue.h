@@ -0,0 +1,146 @@
+#ifndef TYPED_QUEUE_H
+#define TYPED_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "queue_mem.h"
+
+// Typed queues for fixed-size elements (header-only, generated by macro)
+//
+// DEFINE_TYPED_QUEUE(name, T) defines a bounded lock-free MPMC ring that
+// stores elements of type T by value in its slots, with the same per-slot
+// sequence scheme as ring.h. There is no length field, no heap copy and no
+// pointer to follow: enqueue copies a T into a slot and dequeue copies it
+// back out. Every operation is a static inline function, so with a small T
+// the copies compile to a few register moves.
+//
+//     typedef struct Task { uint64_t id; void* arg; } Task;
+//     DEFINE_TYPED_QUEUE(task_queue, Task)
+//
+//     task_queue* tasks = task_queue_init(1024);
+//     task_queue_try_enqueue(tasks, (Task){ 1, NULL });
+//     Task task;
+//     while (task_queue_try_dequeue(tasks, &task)) { ... }
+//     task_queue_destroy(tasks);
+//
+// generates the types name and name_slot and the functions name_init,
+// name_destroy, name_try_enqueue, name_try_dequeue, name_is_empty,
+// name_size and name_capacity. Like RingQueue, a full queue rejects new
+// elements instead of growing. T is copied with plain assignment, so
+// elements left at destroy are simply dropped.
+
+#define DEFINE_TYPED_QUEUE(name, T) \
+    /* Slot: free for position p when sequence == p, full when p + 1 */ \
+    typedef struct name##_slot { \
+        atomic_size_t sequence; \
+        T value; \
+    } name##_slot; \
+    \
+    /* Queue: the read-only fields and each position on their own cache line */ \
+    typedef struct name { \
+        name##_slot* slots; \
+        size_t mask; \
+        _Alignas(QUEUE_CACHELINE) atomic_size_t enqueue_pos; \
+        _Alignas(QUEUE_CACHELINE) atomic_size_t dequeue_pos; \
+    } name; \
+    \
+    /* Initialize an empty queue with capacity_pow2 slots (a power of two, at least 2) */ \
+    static inline name* name##_init(size_t capacity_pow2) { \
+        if (capacity_pow2 < 2 || (capacity_pow2 & (capacity_pow2 - 1)) != 0 || \
+            capacity_pow2 > SIZE_MAX / sizeof(name##_slot)) { \
+            return NULL; \
+        } \
+        name* queue = (name*)queue_mem_alloc_aligned(_Alignof(name), sizeof(name)); \
+        if (queue == NULL) { \
+            return NULL; \
+        } \
+        queue->slots = (name##_slot*)queue_mem_alloc_aligned(QUEUE_CACHELINE, capacity_pow2 * sizeof(name##_slot)); \
+        if (queue->slots == NULL) { \
+            queue_mem_free_aligned(queue); \
+            return NULL; \
+        } \
+        for (size_t i = 0; i < capacity_pow2; i++) { \
+            atomic_init(&queue->slots[i].sequence, i); \
+        } \
+        queue->mask = capacity_pow2 - 1; \
+        atomic_init(&queue->enqueue_pos, 0); \
+        atomic_init(&queue->dequeue_pos, 0); \
+        return queue; \
+    } \
+    \
+    /* Free the queue (must not be called while other threads still use it) */ \
+    static inline void name##_destroy(name* queue) { \
+        if (queue != NULL) { \
+            queue_mem_free_aligned(queue->slots); \
+            queue_mem_free_aligned(queue); \
+        } \
+    } \
+    \
+    /* Try to add an element (returns false if the queue is full) */ \
+    static inline bool name##_try_enqueue(name* queue, T value) { \
+        size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed); \
+        name##_slot* slot; \
+        while (true) { \
+            slot = &queue->slots[pos & queue->mask]; \
+            size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire); \
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos; \
+            if (diff == 0) { \
+                if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos, pos + 1, \
+                                                          memory_order_relaxed, memory_order_relaxed)) { \
+                    break; \
+                } \
+            } else if (diff < 0) { \
+                return false; \
+            } else { \
+                pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed); \
+            } \
+        } \
+        slot->value = value; \
+        atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release); \
+        return true; \
+    } \
+    \
+    /* Try to remove an element into *out (returns false if the queue is empty) */ \
+    static inline bool name##_try_dequeue(name* queue, T* out) { \
+        size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed); \
+        name##_slot* slot; \
+        while (true) { \
+            slot = &queue->slots[pos & queue->mask]; \
+            size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire); \
+            intptr_t diff = (intptr_t)sequence - (intptr_t)(pos + 1); \
+            if (diff == 0) { \
+                if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos, pos + 1, \
+                                                          memory_order_relaxed, memory_order_relaxed)) { \
+                    break; \
+                } \
+            } else if (diff < 0) { \
+                return false; \
+            } else { \
+                pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed); \
+            } \
+        } \
+        *out = slot->value; \
+        atomic_store_explicit(&slot->sequence, pos + queue->mask + 1, memory_order_release); \
+        return true; \
+    } \
+    \
+    /* Get the number of elements (approximate while the queue is in use) */ \
+    static inline size_t name##_size(name* queue) { \
+        size_t dequeued = atomic_load_explicit(&queue->dequeue_pos, memory_order_acquire); \
+        size_t enqueued = atomic_load_explicit(&queue->enqueue_pos, memory_order_acquire); \
+        return enqueued > dequeued ? enqueued - dequeued : 0; \
+    } \
+    \
+    /* Check if the queue is empty */ \
+    static inline bool name##_is_empty(name* queue) { \
+        return name##_size(queue) == 0; \
+    } \
+    \
+    /* Get the number of slots */ \
+    static inline size_t name##_capacity(name* queue) { \
+        return queue->mask + 1; \
+    }
+
+#endif // TYPED_QUEUE_H